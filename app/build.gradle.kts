@@ -53,6 +53,11 @@ android {
         }
     }
 
+    // Keep the model weights uncompressed so the native loader can reference them in place
+    androidResources {
+        noCompress += "bin"
+    }
+
     // Delegate native build to CMAKE
     externalNativeBuild {
         cmake {
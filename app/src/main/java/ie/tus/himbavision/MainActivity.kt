@@ -1,5 +1,6 @@
 package ie.tus.himbavision
 
+import android.content.ComponentCallbacks2
 import android.os.Bundle
 import androidx.activity.ComponentActivity
 import androidx.activity.compose.setContent
@@ -46,6 +47,14 @@ class MainActivity : ComponentActivity() {
             }
         }
     }
+
+    override fun onTrimMemory(level: Int) {
+        super.onTrimMemory(level)
+        // Free the detection model under memory pressure, it is kept while a camera screen uses it
+        if (level >= ComponentCallbacks2.TRIM_MEMORY_RUNNING_LOW) {
+            nanodetncnn.trimModel()
+        }
+    }
 }
 
 @Composable
@@ -0,0 +1,8 @@
+package ie.tus.himbavision.jnibridge
+
+// Receives the obstacle guidance chosen by the native announcement scheduler as soon as it is due.
+// Urgent announcements are close obstacles ahead and should interrupt ongoing speech.
+// Called on the camera thread, implementations should post the text to their own dispatcher
+fun interface AnnouncementListener {
+    fun onAnnouncement(text: String, urgent: Boolean)
+}
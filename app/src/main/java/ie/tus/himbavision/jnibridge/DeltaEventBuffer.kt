@@ -0,0 +1,59 @@
+package ie.tus.himbavision.jnibridge
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+// Follows the track changes written by HimbaJNIBridge.getDeltaEvents from a reused direct ByteBuffer.
+// Each update continues after the last event read, so a consumer only handles what changed.
+// The layout matches EventLog::write in eventlog.h
+class DeltaEventBuffer(maxEvents: Int = MAX_EVENTS) {
+    val buffer: ByteBuffer = ByteBuffer.allocateDirect(HEADER_SIZE + maxEvents * EVENT_SIZE)
+        .order(ByteOrder.LITTLE_ENDIAN)
+
+    // Sequence the next update starts from
+    var nextSequence: Int = 1
+        private set
+
+    // Events lost because the reader fell behind by more than the native ring, in the last update
+    var missedEvents: Int = 0
+        private set
+
+    // Read the events after the last update, returns how many arrived
+    fun update(bridge: HimbaJNIBridge): Int {
+        val written = bridge.getDeltaEvents(nextSequence, buffer)
+        if (written < HEADER_SIZE || buffer.getInt(0) != LAYOUT_VERSION) {
+            return 0
+        }
+
+        missedEvents = buffer.getInt(8) - nextSequence
+        nextSequence = buffer.getInt(12)
+        return eventCount
+    }
+
+    val eventCount: Int get() = buffer.getInt(4)
+
+    fun sequence(i: Int): Int = buffer.getInt(offset(i))
+    fun type(i: Int): Int = buffer.getInt(offset(i) + 4)
+    fun trackId(i: Int): Int = buffer.getInt(offset(i) + 8)
+    fun label(i: Int): Int = buffer.getInt(offset(i) + 12)
+    // Grid zone, row * 3 + col with the far row on top
+    fun zone(i: Int): Int = buffer.getInt(offset(i) + 16)
+    fun previousZone(i: Int): Int = buffer.getInt(offset(i) + 20)
+    fun distance(i: Int): Float = buffer.getFloat(offset(i) + 24)
+    fun steps(i: Int): Int = buffer.getInt(offset(i) + 28)
+
+    private fun offset(i: Int): Int = HEADER_SIZE + i * EVENT_SIZE
+
+    companion object {
+        const val LAYOUT_VERSION = 1
+        const val HEADER_SIZE = 16
+        const val EVENT_SIZE = 32
+        const val MAX_EVENTS = 64
+
+        // Event types, match DeltaEventType in eventlog.h
+        const val ENTER = 0
+        const val EXIT = 1
+        const val ZONE_CHANGE = 2
+        const val DISTANCE_BAND = 3
+    }
+}
@@ -0,0 +1,7 @@
+package ie.tus.himbavision.jnibridge
+
+// Receives the detection sentences pushed by the native render loop.
+// Called on the camera thread, implementations should post the results to their own dispatcher
+fun interface DetectionListener {
+    fun onDetections(detections: Array<String>)
+}
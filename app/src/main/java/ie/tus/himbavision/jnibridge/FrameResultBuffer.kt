@@ -0,0 +1,54 @@
+package ie.tus.himbavision.jnibridge
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+// Reads the frame result written by HimbaJNIBridge.getFrameResult straight from a direct ByteBuffer.
+// The buffer is reused for every poll and the accessors read in place, so polling allocates nothing.
+// The layout matches frame_result_write in frameresult.h
+class FrameResultBuffer(maxObjects: Int = MAX_OBJECTS) {
+    val buffer: ByteBuffer = ByteBuffer.allocateDirect(HEADER_SIZE + maxObjects * OBJECT_SIZE)
+        .order(ByteOrder.LITTLE_ENDIAN)
+
+    // Copy the newest frame into the buffer, false if the native side has no result in this layout
+    fun update(bridge: HimbaJNIBridge): Boolean {
+        val written = bridge.getFrameResult(buffer)
+        return written >= HEADER_SIZE && buffer.getInt(0) == LAYOUT_VERSION
+    }
+
+    val sequence: Int get() = buffer.getInt(4)
+    val timestampMs: Double get() = buffer.getDouble(8)
+    val objectCount: Int get() = buffer.getInt(16)
+    // NAV_* direction of the frame
+    val direction: Int get() = buffer.getInt(20)
+
+    fun label(i: Int): Int = buffer.getInt(offset(i))
+    fun score(i: Int): Float = buffer.getFloat(offset(i) + 4)
+    fun x(i: Int): Float = buffer.getFloat(offset(i) + 8)
+    fun y(i: Int): Float = buffer.getFloat(offset(i) + 12)
+    fun width(i: Int): Float = buffer.getFloat(offset(i) + 16)
+    fun height(i: Int): Float = buffer.getFloat(offset(i) + 20)
+    // Grid zone, row * 3 + col with the far row on top, -1 if out of bounds
+    fun zone(i: Int): Int = buffer.getInt(offset(i) + 24)
+    fun distance(i: Int): Float = buffer.getFloat(offset(i) + 28)
+    // 0 if the object is not tracked
+    fun trackId(i: Int): Int = buffer.getInt(offset(i) + 32)
+    fun steps(i: Int): Int = buffer.getInt(offset(i) + 36)
+
+    private fun offset(i: Int): Int = HEADER_SIZE + i * OBJECT_SIZE
+
+    companion object {
+        const val LAYOUT_VERSION = 1
+        const val HEADER_SIZE = 24
+        const val OBJECT_SIZE = 40
+        const val MAX_OBJECTS = 128
+
+        // Navigation directions, match NavDirection in frameresult.h. NAV_UNKNOWN: no general frame analyzed yet
+        const val NAV_UNKNOWN = -1
+        const val NAV_CONTINUE_AHEAD = 0
+        const val NAV_MOVE_LEFT = 1
+        const val NAV_MOVE_RIGHT = 2
+        const val NAV_SLOW_DOWN = 3
+        const val NAV_NO_PATH = 4
+    }
+}
@@ -2,9 +2,14 @@ package ie.tus.himbavision.jnibridge
 
 import android.content.res.AssetManager
 import android.view.Surface
+import java.nio.ByteBuffer
 
 class HimbaJNIBridge {
     external fun loadModel(assetManager: AssetManager, cpuGpu: Int): Boolean
+    // Reference counted residency, the model stays loaded between screens until trimModel frees it
+    external fun acquireModel(assetManager: AssetManager, cpuGpu: Int): Boolean
+    external fun releaseModel()
+    external fun trimModel(): Boolean
     external fun openCamera(facing: Int): Boolean
     external fun closeCamera(): Boolean
     external fun setOutputWindow(surface: Surface): Boolean
@@ -14,13 +19,67 @@ class HimbaJNIBridge {
     external fun getCenterDetections(): Array<String>
     external fun getMinNavDirections(): Array<String>
     external fun getMaxNavDirections(): Array<String>
+    // Writes the last frame into a direct buffer, read it with FrameResultBuffer. Returns the bytes written or -1
+    external fun getFrameResult(buffer: ByteBuffer): Int
+    // Heading of the last frame as {degrees right of ahead, free valley width in degrees, density ahead 0..1}, empty before the first frame
+    external fun getHeading(): FloatArray
     external fun getFps(): Float
+    external fun setMotionGateEnabled(enabled: Boolean)
+    external fun getMotionGateSkipRate(): Float
+    external fun getMotionGateSavedMs(): Float
+    external fun getInferenceThreads(): Int
+    external fun getCpuPolicyMetrics(): String
+    external fun getModelLoadMetrics(): String
+    external fun setSegmentationEnabled(enabled: Boolean): Boolean
+    // 27 floats: walkable share of the 9 grid zones, their dominant surface label and its share
+    external fun getSurfaceZones(): FloatArray
+    // Compares parallel workers with sequential detect on a CPU instance, blocking, call off the main thread
+    external fun runParallelBenchmark(maxBatch: Int, loops: Int): String
+    // Forward time per detection mode output plan on a CPU instance, blocking, call off the main thread
+    external fun runHeadPlanBenchmark(loops: Int): String
+    // Latency of every bundled detector model and its agreement with the pipeline model (not accuracy, there are no labels), blocking, call off the main thread
+    external fun runDecoderBenchmark(loops: Int): String
+    // DETECT_MODE_FULL or DETECT_MODE_NAVIGATION, selects the detector heads of the general detection
+    external fun setDetectionMode(mode: Int)
     external fun getAllFindDetections(objectName: String): Array<String>
+    external fun clearFindTarget()
+    // 8 floats per hit: label, probability, x, y, width, height, zone index, distance in meters
+    external fun getFindHits(): FloatArray
+    // Detect on a native executor thread, a newer frame cancels one that is still waiting
+    external fun setAsyncDetectionEnabled(enabled: Boolean)
+    // Pushes the detection sentences of every frame with fresh detections, pass null to stop
+    external fun setDetectionListener(listener: DetectionListener?)
+    // Pushes the spoken obstacle guidance of the native scheduler, mode is ANNOUNCE_MINIMAL or ANNOUNCE_MAXIMAL, pass null to stop
+    external fun setAnnouncementListener(listener: AnnouncementListener?, mode: Int)
     external fun getLatestFrame(): ByteArray
     external fun getFocalLengthPx(): Float
 
+    external fun setTrackLastKnownPosition(enabled: Boolean)
+    // Re-detect only in crops around tracked objects between periodic full-frame passes
+    external fun setRoiRedetectionEnabled(enabled: Boolean)
+    // Grid size (1..16 each) and evidence half-life of the obstacle fusion behind the navigation direction
+    external fun configureOccupancyGrid(cols: Int, rows: Int, halfLifeMs: Float): Boolean
+    external fun getRoiMetrics(): String
+    external fun getTrackedObjects(): Array<String>
+    external fun getTrackAnnouncements(): Array<String>
+    // Writes the track changes from a sequence number on into a direct buffer, read it with DeltaEventBuffer. Returns the bytes written or -1
+    external fun getDeltaEvents(fromSequence: Int, buffer: ByteBuffer): Int
+    external fun getLastKnownPosition(objectName: String): String
+    // Last sightings of a class, newest first, 8 floats each: age ms, zone index, distance, box x, y, w, h as frame fractions, score
+    external fun getLastSightings(objectName: String): FloatArray
+    // "<class> last seen <age> ago at <zone>. <steps>" for the newest sighting, empty if never seen
+    external fun getLastSeen(objectName: String): String
+
 
     companion object {
+        // Detection modes, match DetectMode in nanodet.h
+        const val DETECT_MODE_FULL = 0
+        const val DETECT_MODE_NAVIGATION = 1
+
+        // Announcement modes, match AnnounceMode in announcer.h
+        const val ANNOUNCE_MINIMAL = 0
+        const val ANNOUNCE_MAXIMAL = 1
+
         init {
             System.loadLibrary("himbavision")
         }
@@ -88,6 +88,7 @@ import ie.tus.himbavision.utility.Network.isOnline
 import ie.tus.himbavision.utility.Other.rememberSaveableDirections
 import ie.tus.himbavision.utility.Other.rotateFrameRight
 import ie.tus.himbavision.utility.Vibrations.vibrateBasedOnDirection
+import ie.tus.himbavision.utility.Vibrations.vibrateForHeading
 import ie.tus.himbavision.viewmodel.AuthViewModel
 import ie.tus.himbavision.viewmodel.AuthViewModelFactory
 import ie.tus.himbavision.viewmodel.RetrieveVoiceControlDetailsViewModel
@@ -120,6 +121,8 @@ fun HimbaNavScreen(navController: NavController) {
     // State to hold the minimal directions from the JNI
     var minNavDirections by remember { mutableStateOf(emptyArray<String>()) }
     var maxNavDirections by remember { mutableStateOf(emptyArray<String>()) }
+    // Heading of the polar obstacle histogram, see HimbaJNIBridge.getHeading
+    var heading by remember { mutableStateOf(FloatArray(0)) }
 
 
     var panMinNavDirections by remember { mutableStateOf(emptyList<String>()) }
@@ -194,12 +197,20 @@ fun HimbaNavScreen(navController: NavController) {
     }
 
 
-    // LaunchedEffect to periodically fetch directions
+    // Poll the directions for the cards and the vibration only, speech is pushed by the announcement listener
     LaunchedEffect(selectedModel) {
         if (selectedModel == "Object Detection") {
+            // Navigation needs the general detection, stop any find query left running by the home screen
+            nanodetncnn.clearFindTarget()
+            // Surface cautions and blocked zones on device, the panoptic server is no longer required for them
+            val segmentationReady = withContext(Dispatchers.IO) { nanodetncnn.setSegmentationEnabled(true) }
+            if (!segmentationReady) {
+                Log.d("HimbaNavScreen", "On-device segmentation not available")
+            }
             while (true) {
                 minNavDirections = nanodetncnn.getMinNavDirections()
                 maxNavDirections = nanodetncnn.getMaxNavDirections()
+                heading = nanodetncnn.getHeading()
                 delay(1000) // Fetch directions every 1 second
             }
         }
@@ -281,58 +292,36 @@ fun HimbaNavScreen(navController: NavController) {
         }
     }
 
-    fun speakOADirections(context: Context, tts: TextToSpeech) {
-        CoroutineScope(Dispatchers.Main).launch {
-            while (true) {
-                if (selectedModel == "Object Detection" && selectedOption == "Haptic Feedback" || selectedModel == "Image Segmentation" && selectedOption == "Haptic Feedback") {
-                    Log.d("HimbaNavScreen", "Haptic Feedback selected, skipping TTS")
-                    delay(4000) // Wait for 4 seconds before checking again
-                    continue
-                }
-
-                val oADirections = when {
-                    selectedModel == "Object Detection" && selectedOption == "Minimal Navigation" -> minNavDirections
-                    selectedModel == "Object Detection" && selectedOption == "Maximal Navigation" -> maxNavDirections
-                    selectedModel == "Image Segmentation" && selectedOption == "Minimal Navigation" -> panMinNavDirections.toTypedArray()
-                    selectedModel == "Image Segmentation" && selectedOption == "Maximal Navigation" -> panMaxNavDirections.toTypedArray()
-                    else -> minNavDirections
-                }
-
-                // Log the full oADirections array
-                Log.d("HimbaNavScreen", "Current oADirections: ${oADirections.joinToString(", ")}")
-
-                if (oADirections.isEmpty()) {
-                    Log.d("HimbaNavScreen", "No directions detected, waiting...")
-                    delay(4000) // Wait for 4 seconds before rechecking
-                    continue
-                }
-
-                val containsContinue =
-                    oADirections.any { it.contains(Regex(".*continue.*", RegexOption.IGNORE_CASE)) }
-
-                for (oadirection in oADirections) {
-                    Log.d("HimbaNavScreen", "Speaking direction: $oadirection")
-
-                    if (selectedOption == "Minimal Navigation" && containsContinue) {
-                        isContextualNavSpeaking = false
-                        tts?.speak(oadirection, TextToSpeech.QUEUE_FLUSH, null, null)
-                        while (tts?.isSpeaking == true) {
-                            delay(2000)
-                        }
-                        Log.d("HimbaNavScreen", "Finished speaking direction: $oadirection")
-                        delay(4000) // Wait for 4 seconds before speaking the next direction
-                    } else {
-                        isContextualNavSpeaking = true
-                        tts?.speak(oadirection, TextToSpeech.QUEUE_FLUSH, null, null)
-                        while (tts?.isSpeaking == true) {
-                            delay(100)
-                        }
-                        Log.d("HimbaNavScreen", "Finished speaking direction: $oadirection")
-                        delay(1) // Continue with a delay of 1ms
-                    }
-
-                    speakDirections(context, directions, tts!!)
+    // Guidance of the panoptic server is spoken when a response brings new instructions. The on-device guidance is
+    // pushed by the native scheduler, see the announcement listener below
+    var lastSpokenPanDirections by remember { mutableStateOf(emptyList<String>()) }
+    fun speakPanopticDirections(minimal: List<String>?, maximal: List<String>?) {
+        val speaker = tts ?: return
+        if (!isMicEnabled || selectedModel != "Image Segmentation") return
+        val instructions = when (selectedOption) {
+            "Minimal Navigation" -> minimal
+            "Maximal Navigation" -> maximal
+            else -> null
+        } ?: return
+
+        // Repeats are held back here only, the cards keep showing every instruction of the response
+        if (instructions.isEmpty() || instructions == lastSpokenPanDirections) return
+        lastSpokenPanDirections = instructions
+
+        // Obstacles interrupt the route directions, "continue" lets them carry on
+        val containsContinue = instructions.any { it.contains("continue", ignoreCase = true) }
+        isContextualNavSpeaking = !(selectedOption == "Minimal Navigation" && containsContinue)
+        instructions.forEachIndexed { index, instruction ->
+            Log.d("HimbaNavScreen", "Speaking direction: $instruction")
+            speaker.speak(instruction, if (index == 0) TextToSpeech.QUEUE_FLUSH else TextToSpeech.QUEUE_ADD, null, null)
+        }
+        if (isContextualNavSpeaking) {
+            CoroutineScope(Dispatchers.Main).launch {
+                while (speaker.isSpeaking) {
+                    delay(100)
                 }
+                isContextualNavSpeaking = false
+                speakDirections(context, directions, speaker)
             }
         }
     }
@@ -382,6 +371,41 @@ fun HimbaNavScreen(navController: NavController) {
         }
     }
 
+    // Minimal navigation only uses near and mid obstacles, skip the detector head for small far objects
+    LaunchedEffect(selectedModel, selectedOption) {
+        val minimal = selectedModel == "Object Detection" && selectedOption == "Minimal Navigation"
+        nanodetncnn.setDetectionMode(if (minimal) HimbaJNIBridge.DETECT_MODE_NAVIGATION else HimbaJNIBridge.DETECT_MODE_FULL)
+    }
+
+    // Obstacle guidance of the on-device detection is spoken as soon as the native scheduler pushes it
+    DisposableEffect(selectedModel, selectedOption, tts) {
+        val speaker = tts
+        val pushed = speaker != null && selectedModel == "Object Detection" &&
+                (selectedOption == "Minimal Navigation" || selectedOption == "Maximal Navigation")
+        if (pushed) {
+            val mode = if (selectedOption == "Maximal Navigation") HimbaJNIBridge.ANNOUNCE_MAXIMAL else HimbaJNIBridge.ANNOUNCE_MINIMAL
+            val mainHandler = Handler(Looper.getMainLooper())
+            nanodetncnn.setAnnouncementListener({ text, urgent ->
+                mainHandler.post {
+                    speaker?.speak(text, if (urgent) TextToSpeech.QUEUE_FLUSH else TextToSpeech.QUEUE_ADD, null, null)
+                }
+            }, mode)
+        }
+        onDispose {
+            if (pushed) {
+                nanodetncnn.setAnnouncementListener(null, HimbaJNIBridge.ANNOUNCE_MINIMAL)
+            }
+        }
+    }
+
+    // Stop the on-device segmentation when leaving the navigation screen
+    DisposableEffect(Unit) {
+        onDispose {
+            nanodetncnn.setSegmentationEnabled(false)
+            nanodetncnn.setDetectionMode(HimbaJNIBridge.DETECT_MODE_FULL)
+        }
+    }
+
     // Coroutine to fetch and process frames
     DisposableEffect(selectedModel) {
         selectedModel = if (isConnected == "disconnected") "Object Detection" else selectedModel
@@ -428,6 +452,8 @@ fun HimbaNavScreen(navController: NavController) {
                                         Log.d("NavigationPanopt", instruction)
                                     }
                                 }
+
+                                speakPanopticDirections(minimalInstructions, maximalInstructions)
                             } else {
                                 Log.d("NavigationPanopt", "Failed to get navigation instructions.")
                             }
@@ -498,9 +524,6 @@ fun HimbaNavScreen(navController: NavController) {
                         // If the mic gets enabled without the screen recomposing execute the function to speak directions
                         speakDirections(context, directions, tts!!)
 
-                        Log.e("ConfirmationMs", "Object avoidance called")
-                        speakOADirections(context, tts!!)
-
                     }
                 } else {
                     Log.e("HimbaNavScreen", "TextToSpeech initialization failed")
@@ -1070,8 +1093,14 @@ fun HimbaNavScreen(navController: NavController) {
                                     }
                                 }
                             } else {
+                                // Graded by the heading, the canned directions only until the first frame has one
+                                if (heading.isNotEmpty()) {
+                                    vibrateForHeading(context, heading[0], heading[1], heading[2])
+                                }
                                 minNavDirections.forEach { direction ->
-                                    vibrateBasedOnDirection(context, direction)
+                                    if (heading.isEmpty()) {
+                                        vibrateBasedOnDirection(context, direction)
+                                    }
 
                                     Card(
                                         modifier = Modifier
@@ -465,7 +465,8 @@ fun HomeScreen(navController: NavController) {
                                 if (objectText.isEmpty()) {
                                     val detections = nanodetncnn.getAllFindDetections(selectedObject)
                                     Log.d("HomeScreen", selectedObject)
-                                    objectDetectionState.value = detections.joinToString()
+                                    // Nothing in the current frame yet, answer from where it was last seen while the search keeps running
+                                    objectDetectionState.value = if (detections.isEmpty()) nanodetncnn.getLastSeen(selectedObject) else detections.joinToString()
                                     showDialog = true
                                     if (isMicEnabled) {
                                         tts?.setOnUtteranceProgressListener(object : UtteranceProgressListener() {
@@ -504,7 +505,8 @@ fun HomeScreen(navController: NavController) {
                                         // Perform object detection
                                         val detections = nanodetncnn.getAllFindDetections(selectedObject)
                                         Log.d("HomeScreen", selectedObject)
-                                        objectDetectionState.value = detections.joinToString()
+                                        // Nothing in the current frame yet, answer from where it was last seen while the search keeps running
+                                        objectDetectionState.value = if (detections.isEmpty()) nanodetncnn.getLastSeen(selectedObject) else detections.joinToString()
                                         showDialog = true
 
                                         if(isMicEnabled){
@@ -14,7 +14,6 @@ import androidx.compose.ui.viewinterop.AndroidView
 import androidx.lifecycle.DefaultLifecycleObserver
 import androidx.lifecycle.LifecycleOwner
 import ie.tus.himbavision.jnibridge.HimbaJNIBridge
-import ie.tus.himbavision.utility.Nanodet.LoadNanodetModel
 
 
 // Composable function that sets up the Camera Preview
@@ -34,8 +33,8 @@ fun CameraPreview(
     // Variable to track how many times the surface texture is available
     var connectionCount by remember { mutableStateOf(0) }
 
-    // Disposing effect when the lifecycle changes
-    DisposableEffect(key1 = lifecycleOwner) {
+    // Disposing effect when the lifecycle or the CPU/GPU choice changes, a new choice acquires the model again
+    DisposableEffect(key1 = lifecycleOwner, key2 = cpuGpuIndex) {
         // Observer for lifecycle events (pause, resume, create, destroy)
         val observer = object : DefaultLifecycleObserver {
             override fun onPause(owner: LifecycleOwner) {
@@ -49,18 +48,12 @@ fun CameraPreview(
                 currentSurfaceTexture?.let {
                     Log.d("CameraPreview", "Reusing SurfaceTexture onResume")
                     // If SurfaceTexture exists, set it up for use with the camera and model
-                    NewhandleSurfaceTextureAvailable(it, textureWidth, textureHeight, nanodetncnn, facing, cpuGpuIndex, context)
+                    NewhandleSurfaceTextureAvailable(it, textureWidth, textureHeight, nanodetncnn, facing)
                 } ?: run {
                     Log.d("CameraPreview", "SurfaceTexture is null onResume")
                 }
             }
 
-            override fun onCreate(owner: LifecycleOwner) {
-                // Load the NanoDet model when the composable is created
-                LoadNanodetModel(nanodetncnn, cpuGpuIndex, context)
-                Log.d("CameraPreview", "Model loaded onCreate")
-            }
-
             override fun onDestroy(owner: LifecycleOwner) {
                 // Close the camera when the composable is destroyed
                 nanodetncnn.closeCamera()
@@ -68,12 +61,23 @@ fun CameraPreview(
             }
         }
 
+        // Keep the model resident while this preview is shown. This is the only place the preview loads it,
+        // a direct loadModel would bypass the reference count
+        val acquired = nanodetncnn.acquireModel(context.assets, cpuGpuIndex)
+        if (!acquired) {
+            Log.d("CameraPreview", "Failed to load model")
+        }
+
         // Add the lifecycle observer to the lifecycleOwner
         lifecycleOwner.lifecycle.addObserver(observer)
 
         // Cleanup when composable is disposed
         onDispose {
             lifecycleOwner.lifecycle.removeObserver(observer)
+            // The model stays loaded for the next screen, only trimModel frees it
+            if (acquired) {
+                nanodetncnn.releaseModel()
+            }
             // Do not close the camera here
             Log.d("CameraPreview", "CameraPreview onDispose called")
         }
@@ -100,7 +104,7 @@ fun CameraPreview(
                         connectionCount++ // Increment the connection count for debugging
                         Log.d("CameraPreview", "SurfaceTexture available, setting up camera. Connection count: $connectionCount")
                         // Call the function to handle SurfaceTexture and setup camera
-                        handleSurfaceTextureAvailable(st, width, height, nanodetncnn, facing, cpuGpuIndex, context)
+                        handleSurfaceTextureAvailable(st, width, height, nanodetncnn, facing)
                     }
 
                     override fun onSurfaceTextureSizeChanged(
@@ -133,9 +137,7 @@ fun handleSurfaceTextureAvailable(
     width: Int,
     height: Int,
     nanodetncnn: HimbaJNIBridge,
-    facing: Int,
-    cpuGpuIndex: Int,
-    context: Context
+    facing: Int
 ) {
     // Create a Surface object from the SurfaceTexture
     val surface = Surface(surfaceTexture)
@@ -143,9 +145,7 @@ fun handleSurfaceTextureAvailable(
     nanodetncnn.setOutputWindow(surface)
     Log.d("CameraPreview", "SurfaceTexture available, setting up camera")
 
-    // Load the NanoDet model (again, in case it wasn't loaded already)
-    LoadNanodetModel(nanodetncnn, cpuGpuIndex, context)
-
+    // The model was acquired by CameraPreview
     // Open the camera after setting the output window
     nanodetncnn.openCamera(facing)
     Log.d("CameraPreview", "Camera opened")
@@ -157,14 +157,9 @@ fun NewhandleSurfaceTextureAvailable(
     width: Int,
     height: Int,
     nanodetncnn: HimbaJNIBridge,
-    facing: Int,
-    cpuGpuIndex: Int,
-    context: Context
+    facing: Int
 ) {
-    // Load the NanoDet model
-    LoadNanodetModel(nanodetncnn, cpuGpuIndex, context)
-
-    // Open the camera again after loading the model
+    // Open the camera again, the model stays acquired while the preview is shown
     nanodetncnn.openCamera(facing)
     Log.d("CameraPreview", "Camera opened")
 }
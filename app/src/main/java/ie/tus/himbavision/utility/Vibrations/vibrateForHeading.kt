@@ -0,0 +1,50 @@
+package ie.tus.himbavision.utility.Vibrations
+
+import android.content.Context
+import android.os.Vibrator
+import android.os.VibrationEffect
+import android.os.VibratorManager
+import android.os.Build
+import android.annotation.SuppressLint
+import kotlin.math.abs
+import kotlin.math.roundToInt
+
+// Graded vibration for the heading of HimbaJNIBridge.getHeading: the side keeps the pulse counts of
+// vibrateBasedOnDirection (two pulses left, three right), the pulses get longer the further to turn
+// and stronger the closer the obstacle ahead. No vibration while the way ahead is free
+@SuppressLint("NewApi")
+fun vibrateForHeading(context: Context, headingDegrees: Float, valleyWidthDegrees: Float, ahead: Float) {
+    val vibrator = if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.S) {
+        val vibratorManager = context.getSystemService(Context.VIBRATOR_MANAGER_SERVICE) as VibratorManager
+        vibratorManager.defaultVibrator
+    } else {
+        context.getSystemService(Context.VIBRATOR_SERVICE) as Vibrator
+    }
+
+    if (!vibrator.hasVibrator()) {
+        return
+    }
+
+    val pattern = when {
+        // Every direction blocked, same as "Cannot find path, be careful"
+        valleyWidthDegrees <= 0f -> longArrayOf(0, 500, 200, 500, 200, 500)
+        abs(headingDegrees) < 3f -> null
+        else -> {
+            // 60 ms for a slight correction up to 300 ms for a turn at the edge of the view
+            val pulse = (60 + abs(headingDegrees).coerceAtMost(30f) * 8f).toLong()
+            if (headingDegrees < 0f) longArrayOf(0, pulse, 50, pulse) else longArrayOf(0, pulse, 100, pulse, 100, pulse)
+        }
+    } ?: return
+
+    if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
+        val amplitude = (80 + ahead.coerceIn(0f, 1f) * 175f).roundToInt()
+        val amplitudes = IntArray(pattern.size) { i -> if (i % 2 == 1) amplitude else 0 }
+        if (vibrator.hasAmplitudeControl()) {
+            vibrator.vibrate(VibrationEffect.createWaveform(pattern, amplitudes, -1))
+        } else {
+            vibrator.vibrate(VibrationEffect.createWaveform(pattern, -1))
+        }
+    } else {
+        vibrator.vibrate(pattern, -1)
+    }
+}
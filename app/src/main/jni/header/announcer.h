@@ -0,0 +1,65 @@
+// Announcement scheduler for the spoken obstacle guidance.
+//
+// Runs on every drawn frame and decides whether something should be said now. State carries across
+// frames: every announcement is remembered for its repeat interval, so the same sentence is not
+// spoken again while it is unchanged, and ordinary announcements keep a minimum gap so speech does not
+// pile up. Obstacles close ahead in the center column are urgent: they skip the gap and come first.
+// The caller delivers the announcement, see setAnnouncementListener in nanodetncnn.cpp.
+
+// Define header guards
+#ifndef ANNOUNCER_H
+#define ANNOUNCER_H
+
+#include <string>
+#include <vector>
+
+#include "frameresult.h"
+
+// What the ordinary announcements say
+enum AnnounceMode {
+    ANNOUNCE_MINIMAL = 0, // Surface cautions and the navigation direction
+    ANNOUNCE_MAXIMAL = 1  // Surface cautions and every detected class with its steps
+};
+
+// Announcements remembered for the repeat intervals
+#define ANNOUNCE_HISTORY 16
+
+class AnnouncementScheduler {
+public:
+    AnnouncementScheduler();
+
+    // Change what is announced, forgets what was said
+    void set_mode(int mode);
+    int mode() const { return announce_mode; }
+
+    // Forget what was said
+    void reset();
+
+    // Returns true and fills text when an announcement is due for this frame.
+    // urgent is set for close obstacles ahead, which should interrupt ongoing speech
+    bool next(const FrameResult& result, double now_ms, std::string& text, bool& urgent);
+
+    float urgent_distance;   // Center obstacles closer than this in meters are urgent
+    double min_gap_ms;       // Minimum time between two ordinary announcements
+    double repeat_ms;        // An unchanged ordinary announcement is repeated after this
+    double urgent_repeat_ms; // The same urgent obstacle is repeated after this
+
+private:
+    bool said_within(unsigned int key, double now_ms, double interval_ms) const;
+    void remember(unsigned int key, double now_ms);
+
+    int announce_mode;
+    double last_ms;
+
+    struct Entry {
+        unsigned int key;
+        double time_ms;
+    };
+    Entry history[ANNOUNCE_HISTORY];
+    int history_next;
+
+    // Candidate sentences, reused between frames
+    std::vector<std::string> candidates;
+};
+
+#endif // ANNOUNCER_H
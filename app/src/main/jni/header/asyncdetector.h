@@ -0,0 +1,96 @@
+// Asynchronous detection on an internal executor thread.
+//
+// Frames are submitted with a completion callback and detected on a thread owned by the detector,
+// using the shared net of a NanoDet with a worker of its own (see DetectWorker). Only the newest
+// frame waits for the executor: submitting a frame while another one is still waiting cancels the
+// waiting one, so a slow forward pass never builds up a queue of stale frames. A frame that is
+// already in the forward pass always completes.
+
+// Define header guards
+#ifndef ASYNCDETECTOR_H
+#define ASYNCDETECTOR_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nanodet.h"
+
+// Completion status of a request
+enum AsyncDetectStatus {
+    ASYNC_DETECT_DONE = 0,      // Objects hold the detections of the frame
+    ASYNC_DETECT_CANCELLED = 1, // Superseded by a newer frame or cancelled before it ran
+    ASYNC_DETECT_FAILED = -1    // No model was set when the frame came up
+};
+
+// Called once per request on the executor thread, or on the submitting thread when a newer frame cancels it
+//--> request id: value returned by submit()
+//--> find objects: hits of the find query submitted with the frame, empty without one
+//--> inference ms: duration of the forward pass, 0 unless done
+typedef std::function<void(int request_id, int status, const std::vector<Object>& objects, const std::vector<Object>& find_objects, double inference_ms)> AsyncDetectCallback;
+
+class AsyncDetector {
+public:
+    AsyncDetector();
+    ~AsyncDetector(); // Cancels the waiting frame and joins the executor
+
+    // Model used by the following requests, null fails them. The frame in flight keeps its model alive
+    void set_model(const std::shared_ptr<NanoDet>& model);
+
+    // Threads of one forward pass on the executor
+    void set_num_threads(int n);
+
+    // Run on the executor thread when it starts and before it exits, used to attach it to the JVM
+    void set_thread_hooks(const std::function<void()>& on_start, const std::function<void()>& on_exit);
+
+    // Queue a frame for detection and return its request id. The frame is a handle, it must not be written
+    // to until the callback ran. A frame still waiting from an earlier submit is cancelled.
+    // heads is the output plan of the pass, it travels with the frame since the model is shared with the render thread.
+    // find_class_ids are decoded from the same forward pass as a find query, see NanoDet::detect_find
+    int submit(const cv::Mat& rgb, const AsyncDetectCallback& callback, int heads = DETECT_HEAD_ALL, const std::vector<int>& find_class_ids = std::vector<int>());
+
+    // Cancel the waiting frame, if any. Returns true if a request was cancelled
+    bool cancel();
+
+    // True while a frame waits or runs
+    bool busy();
+
+    // Cancel the waiting frame, let the frame in flight finish and join the executor. Later submits are
+    // cancelled, the detector cannot be restarted
+    void stop();
+
+private:
+    struct Request {
+        int id;
+        cv::Mat rgb;
+        int heads;
+        std::vector<int> find_class_ids;
+        AsyncDetectCallback callback;
+    };
+
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread executor;
+    bool stopping;
+
+    std::shared_ptr<NanoDet> model;
+    int num_threads;
+    std::function<void()> on_thread_start;
+    std::function<void()> on_thread_exit;
+
+    // The single waiting slot and whether the executor is in a forward pass
+    bool has_pending;
+    Request pending;
+    bool running;
+    int next_id;
+
+    // Allocators and scratch of the executor, only touched on the executor thread
+    DetectWorker worker;
+};
+
+#endif // ASYNCDETECTOR_H
@@ -0,0 +1,82 @@
+// CPU topology policy for the native pipeline.
+//
+// Inference threads (the render thread and its OpenMP team) are bound to the big cluster, while
+// auxiliary work such as JPEG encoding runs on the little cluster so it does not steal time from
+// the detector. The number of inference threads is chosen by a governor that measures the forward
+// pass at 1, 2, 4 ... big-core threads and keeps the smallest count whose next step up is not
+// clearly faster. Measurements are repeated periodically and when the chosen count drifts, since
+// thermal throttling changes the answer over a session.
+
+// Define header guards
+#ifndef CPUPOLICY_H
+#define CPUPOLICY_H
+
+#include <sched.h>
+#include <string>
+
+class CpuPolicy {
+public:
+    CpuPolicy();
+
+    // Restart the governor for a newly loaded model, a GPU model keeps the big-core count without probing
+    void reset(bool use_gpu);
+
+    // Number of threads the next forward pass should use
+    int inference_threads() const;
+
+    // Bind the calling thread and its OpenMP team to the big cluster, cheap after the first call per thread
+    void bind_inference_thread();
+
+    // Report how long a forward pass with inference_threads() threads took
+    void record_inference_time(double ms, double timestamp_ms);
+
+    // Human readable summary of the topology and the governor decisions
+    std::string metrics() const;
+
+    // Governor settings
+    float min_gain;          // Relative speedup more threads must bring to be worth it
+    int samples_per_count;   // Forward passes measured per thread count, after one warm-up pass
+    double reevaluate_ms;    // Measure all counts again after this long
+    float drift_tolerance;   // Measure again when the chosen count gets this much slower than measured
+
+private:
+    enum { MAX_COUNTS = 8 };
+
+    void start_probe();
+    void settle(double timestamp_ms);
+
+    int big_count;
+    int little_count;
+    bool gpu;
+
+    // Candidate thread counts in increasing order and their measurements
+    int counts[MAX_COUNTS];
+    int num_counts;
+    double sum_ms[MAX_COUNTS];
+    int num_samples[MAX_COUNTS];
+    float avg_ms[MAX_COUNTS];
+
+    int probe;               // Index of the count being measured, -1 once settled
+    bool warm_up;            // The next sample of the probed count is discarded
+    int chosen;              // Index of the chosen count
+    double settled_time_ms;  // When the current choice was made
+    float running_ms;        // Moving average of the chosen count since settling
+    int evaluations;         // Number of completed probes
+
+    int bind_generation;     // Increments on reset so every thread binds again
+};
+
+// Runs the calling thread on the little cluster for the lifetime of the scope, used by encode and other auxiliary
+// work called from JNI. The caller's affinity is restored on exit, since the thread belongs to the Java side
+// (a pooled dispatcher thread or the UI thread) and must not stay pinned
+class LittleCoreScope {
+public:
+    LittleCoreScope();
+    ~LittleCoreScope();
+
+private:
+    cpu_set_t saved;
+    bool restore;
+};
+
+#endif // CPUPOLICY_H
@@ -0,0 +1,74 @@
+// Detection head decoders and model manifests.
+//
+// NanoDet runs the forward pass, everything that depends on the output layout of a particular
+// detector family lives behind HeadDecoder: which blobs to extract and how to turn them into boxes
+// in network input coordinates. A ModelManifest names the assets of a model, its preprocessing and
+// its decoder, so another small ncnn detector can replace NanoDet-Plus without touching the camera,
+// tracking or navigation code. All decoders produce COCO labels.
+
+// Define header guards
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <net.h>
+#include <vector>
+
+// Detection type from nanodet.h
+struct Object;
+
+//Stride heads of the detector, combined into an output plan. Heads left out of the plan are not decoded,
+//and decoders with one output blob per head do not extract them either, so ncnn never runs the layers
+//only they depend on
+enum DetectHead {
+    DETECT_HEAD_STRIDE_8 = 1,  // Finest grid, mostly small and far objects
+    DETECT_HEAD_STRIDE_16 = 2,
+    DETECT_HEAD_STRIDE_32 = 4,
+    DETECT_HEAD_ALL = DETECT_HEAD_STRIDE_8 | DETECT_HEAD_STRIDE_16 | DETECT_HEAD_STRIDE_32
+};
+
+// Output layouts understood by the decoders
+enum DecoderType {
+    DECODER_NANODET_PLUS = 0, // cls_pred_stride_* and dis_pred_stride_* per stride, distribution box regression
+    DECODER_YOLOX = 1,        // One output, per anchor: cx, cy, log w, log h, objectness, class scores
+    DECODER_YOLOV8 = 2        // One output, per anchor: 4 x 16 box distribution bins, class logits
+};
+
+class HeadDecoder {
+public:
+    virtual ~HeadDecoder() {}
+
+    // Name used in logs and benchmark reports
+    virtual const char* name() const = 0;
+
+    // Extract the output blobs and collect the proposals above the threshold in input coordinates.
+    // Decoders are stateless, one instance serves every thread
+    //--> in pad: the network input, its size gives the grid of every stride
+    //--> class ids: COCO labels to score, null scores every class
+    //--> heads: DetectHead bits to decode
+    virtual void decode(ncnn::Extractor& ex, const ncnn::Mat& in_pad, float prob_threshold, const std::vector<int>* class_ids, int heads, std::vector<Object>& proposals) const = 0;
+};
+
+// Shared decoder of a type, null if the type is unknown
+const HeadDecoder* head_decoder(int type);
+
+// Everything a detector needs besides its weights
+struct ModelManifest {
+    const char* name;       // Name used to select the model
+    const char* param_path; // Asset holding the ncnn param
+    const char* model_path; // Asset holding the ncnn weights
+    int decoder;            // DecoderType of the output blobs
+    int target_size;        // Longer side of the network input
+    float mean_vals[3];     // Mean per channel, in the channel order of the input
+    float norm_vals[3];     // Scale per channel applied after the mean
+    const char* input_blob; // Name of the input blob
+    int pixel_type;         // ncnn::Mat pixel conversion from the RGB camera frame
+};
+
+// Number of models in the manifest table, the first one ships with the app
+int model_manifest_count();
+const ModelManifest& model_manifest(int index);
+
+// Manifest with the given name, null if unknown
+const ModelManifest* find_model_manifest(const char* name);
+
+#endif // DECODER_H
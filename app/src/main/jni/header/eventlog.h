@@ -0,0 +1,86 @@
+// Delta event stream of the tracked objects.
+//
+// Instead of the full result of every frame, consumers can follow what changed: a confirmed track
+// entered, left, moved to another grid zone or came one step closer or farther. The log keeps the
+// state of the previous frame per track ID and appends the changes to a ring buffer with increasing
+// sequence numbers. Readers ask for everything after the sequence number they have seen, a reader
+// that falls behind by more than the ring size is told where its events were lost.
+
+// Define header guards
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <mutex>
+
+// Kinds of change
+enum DeltaEventType {
+    DELTA_ENTER = 0,         // A track was confirmed
+    DELTA_EXIT = 1,          // A track was dropped
+    DELTA_ZONE_CHANGE = 2,   // A track moved to another grid zone
+    DELTA_DISTANCE_BAND = 3  // A track moved by at least one step
+};
+
+struct DeltaEvent {
+    unsigned int sequence; // Increases by one per event, starts at 1
+    int type;              // DeltaEventType
+    int track_id;
+    int label;
+    int zone;              // Current GridZone, the last known one for DELTA_EXIT
+    int previous_zone;     // Zone before a DELTA_ZONE_CHANGE, otherwise the current zone
+    float distance;        // Smoothed distance in meters, -1 if unknown
+    int steps;             // Distance in steps of 0.75 m, the band of DELTA_DISTANCE_BAND
+};
+
+// Events kept for slow readers and tracks followed at the same time
+#define EVENT_LOG_CAPACITY 256
+#define EVENT_LOG_MAX_OBJECTS 64
+
+// Binary layout written by EventLog::write and read by DeltaEventBuffer.kt, little-endian 32 bit values
+//--> header: version, event count, sequence of the first event, sequence to continue from
+//--> per event: the fields of DeltaEvent in order
+#define EVENT_LAYOUT_VERSION 1
+#define EVENT_HEADER_SIZE 16
+#define EVENT_RECORD_SIZE 32
+
+class EventLog {
+public:
+    EventLog();
+
+    // Writer side, called by the render thread once per drawn frame while tracking runs
+    void begin_frame();
+    void observe(int track_id, int label, int zone, float distance);
+    // Tracks of the previous frame that were not observed are reported as DELTA_EXIT
+    void end_frame();
+    // Report every followed track as DELTA_EXIT, when tracking stops
+    void clear_objects();
+
+    // Copy up to max_events events starting at from_sequence into events. Returns the number copied.
+    // first is the sequence of the first copied event, larger than from_sequence if older events were overwritten
+    int read(unsigned int from_sequence, DeltaEvent* events, int max_events, unsigned int& first) const;
+
+    // Write the events from from_sequence into a buffer in the binary layout, as many as fit.
+    // Returns the number of bytes written, -1 if the buffer cannot hold the header
+    int write(unsigned int from_sequence, void* data, size_t capacity) const;
+
+    // Sequence the next event will get
+    unsigned int next_sequence() const;
+
+private:
+    void append(int type, const DeltaEvent& state, int previous_zone);
+
+    struct Followed {
+        int track_id;       // 0 if the slot is free
+        int label;
+        int zone;
+        float distance;
+        float band_distance; // Distance at the last band event
+        bool seen;           // Observed in the current frame
+    };
+    Followed objects[EVENT_LOG_MAX_OBJECTS];
+
+    mutable std::mutex mutex;
+    DeltaEvent ring[EVENT_LOG_CAPACITY];
+    unsigned int next_seq;
+};
+
+#endif // EVENTLOG_H
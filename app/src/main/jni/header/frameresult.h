@@ -0,0 +1,169 @@
+// Structured per-frame result of the detection post-processing.
+//
+// NanoDet::draw aggregates the detections of a frame into fixed-size tables indexed by class label
+// and grid zone: the objects with their zone and step count, the closest obstacle per zone, the
+// navigation decision and the confirmed tracks. Filling a FrameResult never allocates. The
+// sentences returned over JNI are generated from it only when a caller asks for them.
+
+// Define header guards
+#ifndef FRAMERESULT_H
+#define FRAMERESULT_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "segmenter.h"
+#include "tracker.h"
+
+// Cells of the 3x3 grid, the index is row * 3 + col with the far row on top
+enum GridZone {
+    ZONE_OUT_OF_BOUNDS = -1,
+    ZONE_FAR_LEFT = 0,
+    ZONE_FAR_CENTER,
+    ZONE_FAR_RIGHT,
+    ZONE_MID_LEFT,
+    ZONE_MID_CENTER,
+    ZONE_MID_RIGHT,
+    ZONE_NEAR_LEFT,
+    ZONE_NEAR_CENTER,
+    ZONE_NEAR_RIGHT,
+    ZONE_COUNT
+};
+
+// Name of a grid zone as used in the sentences, "Out of bounds" for ZONE_OUT_OF_BOUNDS
+const char* grid_zone_name(int zone);
+
+// Navigation decisions of analyze_navigation
+enum NavDirection {
+    NAV_UNKNOWN = -1,        // The result holds no frame of the general detection, nothing may be said
+    NAV_CONTINUE_AHEAD = 0,
+    NAV_MOVE_LEFT,
+    NAV_MOVE_RIGHT,
+    NAV_SLOW_DOWN,
+    NAV_NO_PATH
+};
+
+// Sentence of a navigation decision
+const char* nav_direction_text(int direction);
+
+// Table sizes, the model knows 80 classes and nms keeps far fewer boxes than this
+#define FRAME_MAX_CLASSES 80
+#define FRAME_MAX_DETECTIONS 128
+
+// One object with a known class height
+struct FrameDetection {
+    short label;     // Class label
+    short zone;      // GridZone of the object
+    int steps;       // Distance in steps of 0.75 m, rounded down
+    float prob;      // Detection score
+    float x, y, w, h;// Box in image coordinates
+    float distance;  // Distance in meters
+    int track_id;    // ID of the confirmed track the object belongs to, 0 if not tracked
+};
+
+// One confirmed track matched in this frame
+struct FrameTrack {
+    int id;          // Stable track ID
+    short label;     // Class label
+    short zone;      // Stable GridZone of the track
+    float distance;  // Smoothed distance in meters
+};
+
+struct FrameResult {
+    // Number of the frame, increases with every drawn frame, and its time in milliseconds
+    unsigned int sequence;
+    double timestamp_ms;
+
+    // Objects in detection order and how many of them each class has
+    int num_detections;
+    FrameDetection detections[FRAME_MAX_DETECTIONS];
+    unsigned short class_counts[FRAME_MAX_CLASSES];
+
+    // Closest obstacle per zone, from the detections and the blocked segmentation zones
+    bool zone_occupied[ZONE_COUNT];
+    float zone_distance[ZONE_COUNT];
+
+    // NavDirection of the frame, NAV_UNKNOWN until the general detection analyzed one
+    int direction;
+
+    // Heading from the polar histogram in radians, positive to the right, the width of its free valley
+    // (0 when every direction is blocked) and the obstacle density straight ahead from 0 to 1
+    float heading;
+    float heading_width;
+    float heading_ahead;
+
+    // Surfaces of the frame, caution messages are generated from them
+    bool has_surface;
+    SurfaceZones surface;
+
+    // Confirmed tracks matched in this frame
+    int num_tracks;
+    FrameTrack tracks[MAX_TRACKS];
+
+    // Empty result without a navigation decision, a cleared result never tells the user the way is free
+    void clear();
+
+    // Empty result of the next frame, taken at the given time
+    void begin_frame(double timestamp);
+
+    // Record the distance of an obstacle in a zone, keeping the closest
+    void add_obstacle(int zone, float distance);
+};
+
+// Published results kept for readers, one more than a writer and two readers need
+#define FRAME_SNAPSHOT_SLOTS 4
+
+// Newest published FrameResult, shared by the render thread and any number of reader threads without locks.
+// The writer copies a finished frame into a slot no reader holds and then swaps the published index. A reader
+// pins the published slot with its counter, checks that it is still published and copies it, so it always
+// gets one complete frame and never waits for the detector
+class FrameResultSnapshots {
+public:
+    FrameResultSnapshots();
+
+    // Publish a finished frame, only one thread may publish. Returns -1 if every other slot was pinned and
+    // the frame was dropped, readers then keep getting the previous one
+    int publish(const FrameResult& result);
+
+    // Copy the newest published frame and return its sequence number, 0 before the first frame
+    unsigned int read(FrameResult& result) const;
+
+private:
+    FrameResult slots[FRAME_SNAPSHOT_SLOTS];
+    std::atomic<int> published;
+    mutable std::atomic<int> readers[FRAME_SNAPSHOT_SLOTS];
+};
+
+// Pick the direction with the most room from the obstacles of the near and mid rows
+int analyze_navigation(const FrameResult& result);
+//--> zone tables: ZONE_COUNT entries each, distances of free zones are FLT_MAX
+int analyze_navigation(const bool* zone_occupied, const float* zone_distance);
+
+// Sentences of a frame, generated on demand for the JNI getters. Classes are listed in alphabetical order
+//--> detection sentences: "2 person detected at Near-Left, Mid-Center. Take 1 steps., Take 3 steps."
+void frame_detection_sentences(const FrameResult& result, std::vector<std::string>& sentences);
+//--> object sentence: "Detected <class> at <zone>. <steps>"
+void frame_object_sentence(const FrameDetection& det, std::string& text);
+//--> center sentences: one object sentence per object in a center zone
+void frame_center_sentences(const FrameResult& result, std::vector<std::string>& sentences);
+//--> minimal navigation: surface cautions followed by the navigation decision, nothing for NAV_UNKNOWN
+void frame_min_nav_directions(const FrameResult& result, std::vector<std::string>& directions);
+//--> maximal navigation: surface cautions followed by the detection sentences with steps to walk
+void frame_max_nav_directions(const FrameResult& result, std::vector<std::string>& directions);
+//--> tracks: "Track <id>: <class> at <zone>, <distance> meters"
+void frame_track_sentences(const FrameResult& result, std::vector<std::string>& sentences);
+
+// Binary layout of a FrameResult, written by frame_result_write into a direct ByteBuffer and read by
+// FrameResultBuffer.kt. All values are little-endian 32 bit, bump the version when the layout changes.
+//--> header: version, sequence, timestamp (float64 ms), object count, NavDirection
+//--> per object: label, score, x, y, width, height, GridZone, distance, track ID, steps
+#define FRAME_LAYOUT_VERSION 1
+#define FRAME_HEADER_SIZE 24
+#define FRAME_OBJECT_SIZE 40
+
+// Write the result into a buffer of the given capacity, objects that do not fit are left out.
+// Returns the number of bytes written, -1 if the buffer cannot hold the header
+int frame_result_write(const FrameResult& result, void* data, size_t capacity);
+
+#endif // FRAMERESULT_H
@@ -0,0 +1,42 @@
+// Ground-contact distance estimate.
+//
+// With the camera at a known height above a flat floor, the image row where an object touches the
+// floor gives its distance: the ray through that row meets the floor at height / tan(pitch + ray angle).
+// The distance of every row of the detector frame is kept in a lookup table, rebuilt only when the
+// camera pitch or the intrinsics change, so each object costs one table read. Unlike the class height
+// model this works for any class and for objects cut off at the top, but it needs the bottom of the box
+// to be inside the frame and below the horizon.
+
+// Define header guards
+#ifndef GROUNDPLANE_H
+#define GROUNDPLANE_H
+
+#include <vector>
+
+#include "intrinsics.h"
+
+class GroundPlane {
+public:
+    GroundPlane();
+
+    // Rebuild the table if the intrinsics changed or the pitch moved by more than the update step.
+    // pitch_valid is false when the device orientation is unknown, the estimator is then off
+    void update(const CameraIntrinsics& intrinsics, float pitch, bool pitch_valid);
+
+    // Horizontal distance in meters to the floor point seen at the given row of the detector frame,
+    // -1 if the row is above or too close to the horizon, outside the frame or the table is off
+    float distance_at_row(float row) const;
+
+    // Height of the camera above the floor in meters, a phone held at chest height
+    float camera_height;
+    // Rows whose floor point is farther than this are too close to the horizon to be trusted
+    float max_distance;
+
+private:
+    std::vector<float> row_distances;
+    CameraIntrinsics table_intrinsics;
+    float table_pitch;
+    bool table_valid;
+};
+
+#endif // GROUNDPLANE_H
@@ -0,0 +1,32 @@
+// Pinhole intrinsics of the frames fed to the detector.
+//
+// The focal length is derived once per stream configuration from the characteristics of the camera
+// that was actually opened: the lens focal length, the physical sensor size and the active pixel array,
+// scaled to the stream size with the aspect crop the camera applies to fill it. The crop to the window
+// aspect and the rotation done before detection then move the principal point and swap the axes.
+// The result is plain data, the frame path copies it without locks.
+
+// Define header guards
+#ifndef INTRINSICS_H
+#define INTRINSICS_H
+
+#include <camera/NdkCameraMetadata.h>
+
+struct CameraIntrinsics {
+    bool valid;   // False until the characteristics of an opened camera were read
+    int width;    // Image size the intrinsics refer to
+    int height;
+    float fx;     // Focal length in pixels along the image x and y axes
+    float fy;
+    float cx;     // Principal point in pixels
+    float cy;
+};
+
+// Intrinsics of a stream of the given size from the characteristics of its camera.
+// Returns 0 on success, -1 if the lens or sensor entries are missing
+int camera_stream_intrinsics(const ACameraMetadata* metadata, int stream_w, int stream_h, CameraIntrinsics& intrinsics);
+
+// Intrinsics of the region (x, y, w, h) of a stream frame after the kanna rotate type (1..8, EXIF orientation)
+CameraIntrinsics crop_rotate_intrinsics(const CameraIntrinsics& stream, int x, int y, int w, int h, int rotate_type);
+
+#endif // INTRINSICS_H
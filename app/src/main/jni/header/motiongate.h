@@ -0,0 +1,66 @@
+// Motion and change gate for the detector.
+//
+// The Y plane of each camera frame is reduced to a small grid of block averages and compared
+// with the grid of the last frame that went through inference (the keyframe). A global shift
+// search over the grid gives a coarse camera motion estimate, and the residual difference after
+// that shift tells whether the scene itself changed. When both are below threshold the previous
+// detections are republished instead of running NanoDet again, up to a maximum skip interval.
+
+// Define header guards
+#ifndef MOTIONGATE_H
+#define MOTIONGATE_H
+
+class MotionGate {
+public:
+    MotionGate();
+
+    // Forget the keyframe, the next frame always runs inference
+    void reset();
+
+    // Feed the Y plane of a frame, returns true when inference should run for this frame
+    bool update(const unsigned char* y, int width, int height, int stride, double timestamp_ms);
+
+    // Report how long the forward pass of a non-skipped frame took
+    void record_inference_time(double ms);
+
+    // Fraction of frames skipped since the gate was created (0..1)
+    float skip_rate() const;
+
+    // Estimated CPU time saved by skipped frames in milliseconds
+    double saved_ms() const;
+
+    // Enable or disable gating, a disabled gate runs inference on every frame
+    bool enabled;
+
+    // Thresholds, in grey levels and grid cells
+    float change_threshold;      // Mean absolute difference that counts as a scene change
+    int motion_threshold;        // Global shift in grid cells that counts as camera motion
+    int max_skip_frames;         // Never skip more than this many consecutive frames
+    double max_skip_ms;          // Never reuse results older than this
+
+    // Measurements of the last update, for logging
+    float last_difference;
+    int last_motion_x;
+    int last_motion_y;
+
+private:
+    enum { GRID_W = 32, GRID_H = 24, SEARCH = 2 };
+
+    void downsample(const unsigned char* y, int width, int height, int stride, unsigned char* grid) const;
+
+    // Mean absolute difference between the current grid shifted by (dx, dy) and the keyframe
+    float shifted_difference(int dx, int dy) const;
+
+    unsigned char keyframe[GRID_W * GRID_H];
+    unsigned char current[GRID_W * GRID_H];
+    bool has_keyframe;
+    int skipped_in_a_row;
+    double keyframe_time_ms;
+
+    long long total_frames;
+    long long skipped_frames;
+    double inference_ms_avg;
+    double saved_ms_total;
+};
+
+#endif // MOTIONGATE_H
@@ -23,6 +23,18 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <mutex>
+
+#include "tracker.h" // Multi-object tracker backing trackLastKnownPosition
+#include "segmenter.h" // Walkable surface zones from the on-device segmentation
+#include "decoder.h" // Output decoders and manifests of the supported detector families
+#include "frameresult.h" // Structured per-frame result filled by draw
+#include "intrinsics.h" // Camera intrinsics of the frames passed to draw
+#include "groundplane.h" // Floor contact distances from the camera pitch
+#include "occupancy.h" // Obstacles fused over time for the direction decision
+#include "eventlog.h" // Delta events of the tracked objects
+#include "polarhistogram.h" // Continuous heading from the obstacle directions
+#include "sightings.h" // Last-seen memory of every class
 
 // Define a struct to represent detected objects
 struct Object{
@@ -31,10 +43,32 @@ struct Object{
     float prob; //Probability of the detection
 };
 
+//What the results of the general detection are used for
+enum DetectMode {
+    DETECT_MODE_FULL = 0,       // Every object matters, all heads
+    DETECT_MODE_NAVIGATION = 1  // Minimal navigation only looks at near and mid obstacles, coarse heads only
+};
+
+//Output plan of a detection mode
+int detect_mode_heads(int mode);
+
+//Per-thread state of a detection: allocators, thread count and scratch buffers.
+//The network weights are read-only once loaded, so one NanoDet can serve several threads
+//at the same time as long as every thread brings its own worker
+struct DetectWorker {
+    DetectWorker();
+    ncnn::UnlockedPoolAllocator blob_pool_allocator; //Feature maps of this worker's extractors
+    ncnn::PoolAllocator workspace_pool_allocator; //Layer scratch memory of this worker's extractors
+    int num_threads; //Threads of one forward pass, 1 when frames run in parallel
+    int heads; //DetectHead bits decoded by this worker's passes, the output plan of the instance is not read
+    std::vector<Object> proposals; //Decoded boxes before nms, reused between frames
+};
+
 //Define the NanoDet class
 class NanoDet {
 public:
     NanoDet(); //Constructor
+    ~NanoDet(); //Destructor, releases the mapped weights
     //* mean pointer for example const char* modeltype means modeltype stores the memory address to const char
     //Load model from file
     //--> model type: type of path of the model to be loaded
@@ -47,19 +81,106 @@ public:
     //Load model from Android asset manager
     int load(AAssetManager* mgr, const char* modeltype, int target_size, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
 
+    //Load any model of the manifest table from the asset manager, its decoder replaces the NanoDet-Plus one.
+    //Returns -1 when the assets of the model are not bundled
+    int load(AAssetManager* mgr, const ModelManifest& manifest, bool use_gpu = false);
+
+    //Decoder of the loaded model
+    const HeadDecoder* head() const { return decoder; }
+
+    //Run one synthetic forward pass so the first camera frame does not pay the one-time costs
+    int warm_up();
+
+    //Load timings of the last load from assets, in milliseconds
+    double getModelLoadMs() const { return modelLoadMs; }
+    double getWarmUpMs() const { return warmUpMs; }
+    //True when the weights are referenced in place from the asset mapping
+    bool isModelZeroCopy() const { return modelZeroCopy; }
+
     //Detect objects in an image
     int detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
 
+    //Detect objects and the hits of a find-object query with one forward pass, the query is decoded from the outputs of the general detection
+    //--> class ids: COCO labels of the query, all other classes are skipped while decoding the hits
+    //--> find prob threshold: lower than detect() by default since only the queried classes can match
+    int detect_find(const cv::Mat& rgb, const std::vector<int>& class_ids, std::vector<Object>& objects, std::vector<Object>& find_objects, float prob_threshold = 0.4f, float find_prob_threshold = 0.25f, float nms_threshold = 0.5f);
+    int detect_find(const cv::Mat& rgb, const std::vector<int>& class_ids, std::vector<Object>& objects, std::vector<Object>& find_objects, DetectWorker& worker, float prob_threshold = 0.4f, float find_prob_threshold = 0.25f, float nms_threshold = 0.5f) const;
+
+    //Detect objects with the caller's worker, safe to call from several threads at once as long as the
+    //workers differ and no load() runs. Only detection is shared, draw() keeps per-instance state
+    int detect(const cv::Mat& rgb, std::vector<Object>& objects, DetectWorker& worker, float prob_threshold = 0.4f, float nms_threshold = 0.5f) const;
+
+    //Detect objects in several frames or crops in parallel, one thread per worker pulling the next frame.
+    //This is the batch API: there is no multi-frame forward pass, frames share only the loaded weights
+    int detect_parallel(const std::vector<cv::Mat>& frames, std::vector<std::vector<Object> >& results, DetectWorker* workers, int num_workers, float prob_threshold = 0.4f, float nms_threshold = 0.5f) const;
+
+    //Detect objects inside regions of the image only. Every region is padded for context, resized with the scale
+    //of a full-frame pass (small regions get a little more) and run through its own forward pass.
+    //--> lost: indexes of the regions where no object overlaps the region itself
+    int detect_rois(const cv::Mat& rgb, const std::vector<cv::Rect_<float> >& rois, std::vector<Object>& objects, std::vector<int>& lost, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
+
+    //Detect with ROI-guided re-detection when enabled and tracking runs: between periodic full-frame passes
+    //only the predicted boxes of the confirmed tracks are detected again, a track its crop lost adds a
+    //full-frame pass. Crops whose inputs add up to half a full-frame input run one full-frame pass instead.
+    //Behaves like detect() otherwise
+    int detect_tracked(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
+
+    //Switch ROI-guided re-detection in detect_tracked()
+    void set_roi_redetection(bool enabled) { roiRedetection = enabled; }
+
+    //Passes run by detect_tracked() and their average duration, in milliseconds
+    std::string getRoiMetrics() const;
+
     //Draw detected object on an image
-    int draw(cv::Mat& rgb, const std::vector<Object>& objects);
+    //--> fresh: false when the objects are republished from an earlier inference, the tracker, the occupancy grid and
+    //    the polar histogram only count new detections
+    int draw(cv::Mat& rgb, const std::vector<Object>& objects, bool fresh = true);
+
+    //Draw the hits of a find-object query and publish them to g_findDetections and g_findHits
+    int draw_find(cv::Mat& rgb, const std::vector<Object>& objects);
+
+    //Stride heads extracted by the next forward passes without a worker, see DetectHead. Passes with a worker
+    //use the heads of the worker, so this may change while another thread detects with one
+    void set_output_plan(int heads) { outputHeads = heads; }
+
+    //Threads used by the next forward passes, 0 keeps the count chosen at load time
+    void set_num_threads(int n) { num_threads = n; }
+
+    //True when the loaded model runs on Vulkan
+    bool uses_gpu() const { return nanodet.opt.use_vulkan_compute; }
+
+    //Surface zones of the current frame from the segmentation stage, null when the stage is off.
+    //Blocked zones count as obstacles in the navigation analysis and surfaces add caution messages
+    void set_surface_zones(const SurfaceZones* zones) { surfaceZones = zones; }
+
+    //Intrinsics of the frames passed to draw, the vertical focal length turns object heights into distances.
+    //The camera thread sets them before every draw, nothing is looked up on the frame path
+    void set_camera_intrinsics(const CameraIntrinsics& intrinsics) { cameraIntrinsics = intrinsics; }
+
+    //Tilt of the camera below the horizon in radians, objects whose floor contact is visible get their distance from it
+    void set_camera_pitch(float pitch, bool valid) { cameraPitch = pitch; cameraPitchValid = valid; }
 
     // Public flag to toggle tracking behavior
     bool trackLastKnownPosition = false;
 
+    //Grid size and occupancy half-life of the obstacle fusion behind the navigation direction, clears the grid
+    void configure_occupancy_grid(int cols, int rows, float half_life_ms) { occupancyGrid.configure(cols, rows, half_life_ms); }
+
+    //Take over the tracks, last known positions, obstacle grid and heading state of the instance being replaced,
+    //so a model swap does not restart track IDs or announcements
+    void adopt_tracking_state(NanoDet& other);
+
+    // Last known GridZone of a tracked class label, ZONE_OUT_OF_BOUNDS if it was not seen while tracking
+    int getLastKnownZone(int label) const { return (label >= 0 && label < FRAME_MAX_CLASSES) ? lastKnownZones[label] : ZONE_OUT_OF_BOUNDS; }
 
 
 
 private:
+    // Shared body of the detect functions, worker is null to use the allocators and thread count of the instance
+    // and input_scale is 0 to fit target_size. find_objects is null unless a find query is decoded as well
+    int detect_impl(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold, DetectWorker* worker, float input_scale,
+                    const std::vector<int>* find_class_ids, float find_prob_threshold, std::vector<Object>* find_objects) const;
+
     ncnn::Net nanodet; //NCNN neural network object
     int target_size; //Target size for the input image
     float mean_vals[3]; //Mean RGB values for normalization
@@ -68,22 +189,74 @@ private:
     ncnn::UnlockedPoolAllocator blob_pool_allocator;
     // Memory allocator for storing temporary data in blocks during computations
     ncnn::PoolAllocator workspace_pool_allocator;
+    // Thread count override for the extractor
+    int num_threads;
+    // Stride heads to extract and decode
+    int outputHeads;
+    // Output decoder, input blob and pixel conversion of the loaded model
+    const HeadDecoder* decoder;
+    std::string inputBlob;
+    int pixelType;
+    void apply_manifest(const ModelManifest& manifest);
 
-    // Map to track last known positions of each detected object type
-    std::map<std::string, std::string> lastKnownPositions;
+    // Surface zones used by the next draw, owned by the caller
+    const SurfaceZones* surfaceZones;
 
-    // Focal length in pixels
-    float focalLengthPx;
+    // Weights asset kept open while the net references its buffer
+    AAsset* model_asset;
+    bool modelZeroCopy;
+    double modelLoadMs;
+    double warmUpMs;
+    void release_model_asset();
 
-    // Flag to check if focal length has been initialized
-    bool focalLengthInitialized;
+    // ROI-guided re-detection state of detect_tracked()
+    bool roiRedetection;
+    int roiPassesSinceFull; // Crop passes since the last full-frame pass
+    int fullPasses;
+    int roiPasses;
+    double fullPassMs; // Total time of the full-frame passes
+    double roiPassMs;  // Total time of the crop passes
 
-    // Mutex to ensure thread-safe initialization
-    std::mutex focalLengthMutex;
+    // Last known GridZone of each class label
+    int lastKnownZones[FRAME_MAX_CLASSES];
+    void clear_last_known_zones();
+
+    // Tracker assigning stable IDs to detections across frames
+    Tracker tracker;
+    bool trackerRunning;
+
+    // Per-detection distance and grid zone of the current frame, reused between frames
+    std::vector<float> frameDistances;
+    std::vector<int> frameZones;
+    // Index of each detection in the detections of the frame result, -1 if it has none
+    std::vector<int> frameDetections;
+
+    // Intrinsics of the frame being drawn
+    CameraIntrinsics cameraIntrinsics;
+
+    // Camera pitch and the floor distance table built from it
+    float cameraPitch;
+    bool cameraPitchValid;
+    GroundPlane groundPlane;
+
+    // Obstacles of the recent frames
+    OccupancyGrid occupancyGrid;
+
+    // Obstacle density per direction of the current frame
+    PolarHistogram polarHistogram;
 };
 
-// Declare the global focal length variable
-extern float globalFocalLengthPx;
+// Number of floats per hit in g_findHits: label, prob, x, y, width, height, zone index, distance
+#define FIND_HIT_STRIDE 8
+
+// Class name of a COCO label, "unknown" if out of range
+const char* nanodet_class_name(int label);
+
+// COCO label of a class name, -1 if the model does not know the class
+int nanodet_class_id(const std::string& name);
+
+// COCO label of the class a spoken or typed query asks for, such as "cups" or "where is my cup", -1 if it names none
+int nanodet_query_class_id(const std::string& query);
 
 
 #endif //NANODET_H
\ No newline at end of file
@@ -28,6 +28,8 @@
 #include <media/NdkImageReader.h> // Provides access to the ImageReader API
 #include <opencv2/core/core.hpp> // Provides access to OpenCV library for image processing
 
+#include "intrinsics.h" // Pinhole intrinsics of the stream and of the frames fed to the detector
+
 
 // Define NdkCamera class
 class NdkCamera {
@@ -50,8 +52,8 @@ public:
 
     cv::Mat get_latest_frame() const;
 
-    // Function to get focal length in pixels
-    static float getFocalLengthPX(ACameraManager* cameraManager, const char* cameraId);
+    // Intrinsics of the camera stream, set by open() for the opened camera before the first frame arrives
+    const CameraIntrinsics& stream_intrinsics() const { return stream_camera_intrinsics; }
 
 
 
@@ -72,6 +74,9 @@ private:
 
     mutable std::mutex frame_mutex;
     mutable cv::Mat latest_frame;
+
+protected:
+    CameraIntrinsics stream_camera_intrinsics;
 };
 
 // Define NdkCameraWindow class that inherits from NdkCamera
@@ -84,19 +89,31 @@ public:
 
     // Set native window for rendering
     void set_window(ANativeWindow* win);
+    // Virtual function to inspect the Y plane of the cropped and rotated frame, called right before on_image_render
+    virtual void on_image_luma(const unsigned char* y, int width, int height) const;
     // Virtual function to handle image rendering in cv::Mat format
     virtual void on_image_render(cv::Mat& rgb) const;
     // Virtual function to handle image in NV21 format
     virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
 
+    // Intrinsics of the cropped and rotated frame passed to on_image_luma and on_image_render, only valid on the camera thread
+    const CameraIntrinsics& frame_intrinsics() const { return frame_camera_intrinsics; }
+
 public:
     mutable int accelerometer_orientation; // Orientation from accelerometer sensor
+    mutable float camera_pitch; // Smoothed tilt of the optical axis below the horizon in radians, from the accelerometer
+    mutable bool camera_pitch_valid; // False until the first accelerometer event
 
 private:
     ASensorManager* sensor_manager; // Sensor manager handle
     mutable ASensorEventQueue* sensor_event_queue; // Sensor event queue handle
     const ASensor* accelerometer_sensor; // Accelerometer sensor handle
     ANativeWindow* win; // Native window handle for rendering
+
+    // Intrinsics of the current crop and rotation, recomputed when the window or the device orientation changes
+    mutable CameraIntrinsics frame_camera_intrinsics;
+    mutable int frame_crop[5]; // x, y, w, h and rotate type the intrinsics were computed for
+    mutable float frame_stream_focal; // Stream focal length they were computed from, 0 if unknown
 };
 
 // End of header guards
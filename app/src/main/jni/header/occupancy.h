@@ -0,0 +1,80 @@
+// Temporal occupancy grid in image space.
+//
+// A single frame decides little: one missed detection empties a zone and flips the navigation
+// instruction. The grid splits the detector frame into cols x rows cells and fuses the obstacles of
+// every frame into them. Each observation raises the occupancy of the cells under the bottom edge of
+// the box and blends in its distance, and occupancy decays exponentially with the time since the last
+// observation. Cells switch to occupied above one threshold and back to free below a lower one, so a
+// zone does not toggle on a detection near the threshold. The cells are folded into the 3x3 zones
+// for the direction decision. All state lives in fixed arrays, updating never allocates.
+
+// Define header guards
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include "frameresult.h"
+
+// Largest grid, the cell arrays are sized for it
+#define OCCUPANCY_MAX_COLS 16
+#define OCCUPANCY_MAX_ROWS 16
+
+class OccupancyGrid {
+public:
+    OccupancyGrid();
+
+    // Change the grid size (clamped to 1..OCCUPANCY_MAX_*) and the half-life of the occupancy, clears the grid
+    void configure(int cols, int rows, float half_life_ms);
+
+    // Forget all obstacles
+    void reset();
+
+    // Start the frame of the given size and time, decaying the occupancy since the previous frame
+    void begin_frame(int width, int height, double timestamp_ms);
+
+    // Obstacle whose box has its bottom edge at y between x0 and x1, distance in meters
+    void observe_box(float x0, float x1, float y, float distance);
+
+    // Obstacle filling one of the 3x3 zones, as reported by the segmentation
+    void observe_zone(int zone, float distance);
+
+    // Close the frame, fold the new observations into the cells and the cells into the 3x3 zones
+    void end_frame();
+
+    // NavDirection from the fused zones
+    int direction() const { return analyze_navigation(zone_occupied, zone_distance); }
+
+    int cols() const { return grid_cols; }
+    int rows() const { return grid_rows; }
+
+    // Occupancy of a cell, 0..1
+    float occupancy(int col, int row) const { return cell_occupancy[row * OCCUPANCY_MAX_COLS + col]; }
+
+    // Fused zone tables in the format of FrameResult, distances of free zones are FLT_MAX
+    bool zone_occupied[ZONE_COUNT];
+    float zone_distance[ZONE_COUNT];
+
+    // Evidence added by one observation and the occupancy thresholds of a cell, hit_weight must stay below
+    // occupied_threshold so that a cell needs more than one frame of evidence
+    float hit_weight;
+    float occupied_threshold;
+    float free_threshold;
+
+private:
+    void observe_cell(int col, int row, float distance);
+
+    int grid_cols;
+    int grid_rows;
+    float half_life;
+    int frame_width;
+    int frame_height;
+    double last_timestamp_ms;
+
+    float cell_occupancy[OCCUPANCY_MAX_ROWS * OCCUPANCY_MAX_COLS];
+    float cell_distance[OCCUPANCY_MAX_ROWS * OCCUPANCY_MAX_COLS];
+    bool cell_occupied[OCCUPANCY_MAX_ROWS * OCCUPANCY_MAX_COLS];
+
+    // Closest observation of each cell in the current frame, FLT_MAX if none
+    float frame_hits[OCCUPANCY_MAX_ROWS * OCCUPANCY_MAX_COLS];
+};
+
+#endif // OCCUPANCY_H
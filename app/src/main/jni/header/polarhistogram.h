@@ -0,0 +1,92 @@
+// Polar obstacle histogram for a continuous heading.
+//
+// The 3x3 grid only tells left, center or right. In the manner of a vector field histogram, the
+// horizontal field of view of the camera is split into POLAR_BINS equal angles. Every obstacle covers
+// the bins between the angles of its box edges, widened by half a body width at its distance so that a
+// free bin is a direction the user fits through, and adds a density that grows as it gets closer. The
+// smoothed density is split into blocked and free bins with hysteresis. The heading is the free direction
+// closest to straight ahead, or the middle of a free valley too narrow to choose within.
+// Obstacles are kept in flat arrays and every step loops over all of them with a fixed bin count, so the
+// compiler vectorizes the loops and a frame costs a few thousand multiply-adds. Updating never allocates.
+
+// Define header guards
+#ifndef POLARHISTOGRAM_H
+#define POLARHISTOGRAM_H
+
+#include "intrinsics.h"
+
+// Angular bins across the field of view, about 2 degrees each on a phone camera
+#define POLAR_BINS 36
+// Obstacles of one frame, more are left out
+#define POLAR_MAX_OBSTACLES 128
+
+class PolarHistogram {
+public:
+    PolarHistogram();
+
+    // Bin angles of the frames with these intrinsics, only recomputed when they change.
+    // Returns -1 if the intrinsics are invalid
+    int configure(const CameraIntrinsics& intrinsics);
+
+    // Forget all obstacles and the blocked bins
+    void reset();
+
+    // Start collecting the obstacles of a frame
+    void begin_frame();
+
+    // Obstacle spanning the image columns x0..x1 at a distance in meters
+    void add_obstacle(float x0, float x1, float distance);
+
+    // Fill the histogram from the collected obstacles and pick the heading
+    void end_frame();
+
+    // Heading in radians from straight ahead, positive to the right
+    float heading() const { return heading_angle; }
+
+    // Angular width of the free valley holding the heading in radians, 0 when every direction is blocked
+    float valley_width() const { return heading_width; }
+
+    // Obstacle density straight ahead, 0 when free and 1 for an obstacle at the camera
+    float ahead() const { return ahead_density; }
+
+    // Angle of the center of a bin in radians
+    float bin_angle(int bin) const { return min_angle + (bin + 0.5f) * bin_width; }
+
+    // Smoothed density and state of every bin
+    float density[POLAR_BINS];
+    bool blocked[POLAR_BINS];
+
+    // Meters added to both sides of an obstacle
+    float body_half_width;
+    // Obstacles at or beyond this distance in meters add no density
+    float range;
+    // Density thresholds of a bin becoming blocked and free again
+    float blocked_threshold;
+    float free_threshold;
+    // Valleys wider than this many bins hold the heading closest to straight ahead, narrower ones their middle
+    int wide_valley_bins;
+
+private:
+    // Intrinsics the bins were computed for
+    int frame_width;
+    float frame_fx;
+    float frame_cx;
+
+    float min_angle;
+    float bin_width;
+    // Tangent of the bin edges, the image column of an edge is cx + fx * tan
+    float edge_tan[POLAR_BINS + 1];
+    int ahead_bin;
+
+    // Obstacles of the frame as tangents of their widened edges and their density
+    int num_obstacles;
+    float obstacle_left[POLAR_MAX_OBSTACLES];
+    float obstacle_right[POLAR_MAX_OBSTACLES];
+    float obstacle_weight[POLAR_MAX_OBSTACLES];
+
+    float heading_angle;
+    float heading_width;
+    float ahead_density;
+};
+
+#endif // POLARHISTOGRAM_H
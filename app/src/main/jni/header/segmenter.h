@@ -0,0 +1,129 @@
+// On-device semantic segmentation of walkable surfaces.
+//
+// A small ncnn segmentation model runs at low resolution beside NanoDet and labels every pixel
+// with one of the surface classes below. The label map is summarised per 3x3 grid zone, using the
+// same zones as the detector, so navigation can flag blocked zones and unsafe surfaces without the
+// round trip to the panoptic server. Road and stairs are surfaces but not walkable: they count as
+// hazards, never as free floor. The model runs on a SegmentationWorker thread, not the render thread.
+
+// Define header guards
+#ifndef SEGMENTER_H
+#define SEGMENTER_H
+
+#include <opencv2/core/core.hpp>
+#include <net.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Surface labels of the segmentation model, index 0 covers everything that is not a surface
+enum SurfaceClass {
+    SURFACE_OTHER = 0,
+    SURFACE_FLOOR,
+    SURFACE_FLOOR_WOOD,
+    SURFACE_RUG,
+    SURFACE_ROAD,
+    SURFACE_PAVEMENT,
+    SURFACE_GRASS,
+    SURFACE_DIRT,
+    SURFACE_GRAVEL,
+    SURFACE_SAND,
+    SURFACE_SNOW,
+    SURFACE_STAIRS,
+    SURFACE_BRIDGE,
+    SURFACE_BLANKET,
+    SURFACE_CLASS_COUNT
+};
+
+// Name of a surface label, matching SURFACE_CLASSES of the panoptic server
+const char* surface_class_name(int label);
+
+// True for surfaces a blind user can be guided onto, false for SURFACE_OTHER and the hazards
+bool surface_is_walkable(int label);
+
+// True for surfaces that must never be treated as a free path: traffic on roads, drop-offs on stairs
+bool surface_is_hazard(int label);
+
+// Per-zone summary of the label map, zone index is row * 3 + col like the detector grid
+struct SurfaceZones {
+    bool valid;              // False until the first mask was computed
+    float walkable[9];       // Fraction of the zone covered by walkable surfaces
+    float hazard[9];         // Fraction of the zone covered by hazard surfaces
+    int dominant[9];         // Most frequent surface class in the zone, SURFACE_OTHER if none
+    float dominant_share[9]; // Fraction of the zone covered by the dominant surface
+};
+
+class Segmenter {
+public:
+    Segmenter();
+
+    //True when the assets of the model are bundled, checked before anything is built
+    static bool available(AAssetManager* mgr, const char* modeltype);
+
+    //Load model from Android asset manager, returns -1 when the model is not available
+    //--> target width, target height: input resolution of the model
+    int load(AAssetManager* mgr, const char* modeltype, int target_width, int target_height, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
+
+    //Label an image and summarise the labels per grid zone
+    int segment(const cv::Mat& rgb, SurfaceZones& zones);
+
+    //Label map of the last segment() call at model resolution (CV_8UC1)
+    const cv::Mat& mask() const { return label_mask; }
+
+    //Caution messages for surfaces under and just ahead of the user, same wording as the panoptic server
+    static void caution_messages(const SurfaceZones& zones, std::vector<std::string>& messages);
+
+private:
+    ncnn::Net segnet; //NCNN neural network object
+    int target_width; //Input width of the model
+    int target_height; //Input height of the model
+    float mean_vals[3]; //Mean RGB values for normalization
+    float norm_vals[3]; //RGB normalization values
+    ncnn::UnlockedPoolAllocator blob_pool_allocator;
+    ncnn::PoolAllocator workspace_pool_allocator;
+
+    // Label map reused between frames
+    cv::Mat label_mask;
+};
+
+// Runs a Segmenter on a thread of its own, the render thread only hands over frames and picks up the zones.
+// A frame offered while the previous one is still being labelled is not taken, surfaces change slowly
+class SegmentationWorker {
+public:
+    SegmentationWorker();
+    ~SegmentationWorker(); // Joins the thread
+
+    // Segmenter of the following frames, null stops labelling. A frame being labelled keeps its segmenter alive
+    void set_segmenter(const std::shared_ptr<Segmenter>& segmenter);
+
+    // Copy a frame for labelling, returns false if the worker is busy or has no segmenter
+    bool submit(const cv::Mat& rgb);
+
+    // Zones of the newest labelled frame, invalid before the first one
+    void latest(SurfaceZones& zones);
+
+    // Forget the zones, the next ones come from a frame submitted after this call
+    void clear();
+
+    // Let the frame being labelled finish and join the thread, later submits are refused
+    void stop();
+
+private:
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+    bool stopping;
+
+    std::shared_ptr<Segmenter> segmenter;
+    cv::Mat pending;     // Frame waiting for the thread, empty when none
+    bool busy;           // A frame waits or is being labelled
+    int generation;      // Increments on clear(), results of older frames are dropped
+    SurfaceZones zones;
+};
+
+#endif // SEGMENTER_H
@@ -0,0 +1,61 @@
+// Last-seen memory of every class.
+//
+// "Where did I leave my cup?" should not have to wait for a new detection. Every drawn frame records
+// its objects here, per class label: when, in which grid zone, how far away and where in the frame the
+// box was, so a stored preview could be cropped to it. Each class keeps its last SIGHTINGS_PER_CLASS
+// sightings in a small ring. A sighting in the same zone shortly after the newest one refreshes it
+// instead of pushing the older places out. The table is a fixed array indexed by label: recording and
+// lookup are O(1) and memory stays bounded. The render thread records and JNI readers copy under a
+// short lock of the memory's own, never the render lock.
+
+// Define header guards
+#ifndef SIGHTINGS_H
+#define SIGHTINGS_H
+
+#include <mutex>
+#include <string>
+
+#include "frameresult.h"
+
+// Sightings kept per class
+#define SIGHTINGS_PER_CLASS 4
+
+// Floats per sighting returned over JNI: age in ms, GridZone, distance in meters, box x, y, width and
+// height as fractions of the frame, detection score
+#define SIGHTING_STRIDE 8
+
+struct Sighting {
+    double timestamp_ms; // When the object was last seen at this place
+    int zone;            // GridZone, ZONE_OUT_OF_BOUNDS if unknown
+    float distance;      // Distance in meters, -1 if unknown
+    float x, y, w, h;    // Box as fractions of the frame width and height
+    float prob;          // Detection score
+};
+
+class SightingMemory {
+public:
+    SightingMemory();
+
+    // Record a sighting of a class label, labels outside the class table are ignored
+    void record(int label, const Sighting& sighting);
+
+    // Copy up to max sightings of a label, newest first. Returns how many were copied, 0 if it was never seen
+    int read(int label, Sighting* sightings, int max) const;
+
+    // Forget every sighting
+    void clear();
+
+    // A sighting in the zone of the newest one within this many milliseconds refreshes it
+    double merge_ms;
+
+private:
+    mutable std::mutex mutex;
+    Sighting entries[FRAME_MAX_CLASSES][SIGHTINGS_PER_CLASS];
+    int newest[FRAME_MAX_CLASSES]; // Ring index of the newest sighting
+    int counts[FRAME_MAX_CLASSES];
+};
+
+// "<class> last seen <age> ago at <zone>. <steps>", with the steps of the detection sentences
+void sighting_sentence(int label, const Sighting& sighting, double now_ms, std::string& text);
+
+#endif // SIGHTINGS_H
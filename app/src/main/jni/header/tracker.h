@@ -0,0 +1,91 @@
+// Multi-object tracker for NanoDet detections.
+//
+// SORT-style tracking: every track carries a constant-velocity Kalman filter per box
+// coordinate (center x, center y, width, height) and detections are assigned to the
+// predicted boxes by greedy IoU matching within the same class.
+// Track slots are preallocated so the per-frame update never allocates.
+
+// Define header guards
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+// Detection type from nanodet.h
+struct Object;
+
+// Maximum number of objects tracked at the same time
+#define MAX_TRACKS 32
+
+// One dimensional constant-velocity Kalman filter (state = position, velocity)
+struct KalmanAxis {
+    float x;   // Position estimate
+    float v;   // Velocity estimate (units per second)
+    float p00; // Covariance of position
+    float p01; // Covariance of position and velocity
+    float p11; // Covariance of velocity
+};
+
+// A tracked object, lives in a fixed slot of the tracker
+struct Track {
+    int id;                  // Stable track ID, 0 means the slot is free
+    int label;               // Class label of the tracked object
+    float prob;              // Probability of the last matched detection
+    KalmanAxis axes[4];      // Filters for center x, center y, width and height
+    int hits;                // Number of frames the track was matched
+    int misses;              // Consecutive frames without a match
+    bool matched;            // Matched in the latest update
+    float smoothed_distance; // Exponentially smoothed distance in meters, -1 if unknown
+    int zone;                // Stable grid zone index (row * 3 + col), -1 if unknown
+    int pending_zone;        // Candidate zone waiting for confirmation
+    int pending_count;       // Consecutive frames the candidate zone was observed
+    int announced_zone;      // Zone at the last announcement, -1 if never announced
+    float announced_distance;// Distance at the last announcement
+
+    // Current box estimate in image coordinates
+    cv::Rect_<float> rect() const;
+};
+
+class Tracker {
+public:
+    Tracker();
+
+    // Drop all tracks and restart IDs
+    void reset();
+
+    // Predict all tracks to the given time and match them with the detections of one frame.
+    // distances and zones are per detection (same order as objects), zone is the grid index or -1.
+    // After the call, detection_track_ids()[i] holds the track ID assigned to objects[i].
+    void update(const std::vector<Object>& objects, const float* distances, const int* zones, double timestamp_ms);
+
+    // Returns true and marks the track as announced when its zone or distance band changed since the last announcement
+    bool take_announcement(Track& track);
+
+    // Confirmed tracks have been matched on enough frames to be reported
+    bool is_confirmed(const Track& track) const;
+
+    // Box of a track extrapolated to the given time without changing the filter, used to place crops
+    cv::Rect_<float> predicted_rect(const Track& track, double timestamp_ms) const;
+
+    Track* tracks() { return slots; }
+    const Track* tracks() const { return slots; }
+    const std::vector<int>& detection_track_ids() const { return det_track_ids; }
+
+private:
+    Track slots[MAX_TRACKS];
+    int next_id;
+    double last_timestamp_ms;
+
+    // Scratch buffers reused between frames
+    struct Candidate {
+        float iou;
+        int track;
+        int detection;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<int> det_track_ids;
+    std::vector<int> det_slots;
+};
+
+#endif // TRACKER_H
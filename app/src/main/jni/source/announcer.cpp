@@ -0,0 +1,126 @@
+// Announcement scheduler for the spoken obstacle guidance, see announcer.h
+
+#include "../header/announcer.h"
+
+// FNV-1a hash of a sentence, the history stores keys instead of strings
+static unsigned int sentence_key(const std::string& text)
+{
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+AnnouncementScheduler::AnnouncementScheduler()
+{
+    urgent_distance = 1.5f;
+    min_gap_ms = 2500.0;
+    urgent_repeat_ms = 3000.0;
+
+    set_mode(ANNOUNCE_MINIMAL);
+}
+
+void AnnouncementScheduler::set_mode(int mode)
+{
+    announce_mode = mode == ANNOUNCE_MAXIMAL ? ANNOUNCE_MAXIMAL : ANNOUNCE_MINIMAL;
+
+    // Same repeat intervals as the polled directions, the maximal sentences change more often
+    repeat_ms = announce_mode == ANNOUNCE_MAXIMAL ? 10000.0 : 6000.0;
+
+    reset();
+}
+
+void AnnouncementScheduler::reset()
+{
+    for (int i = 0; i < ANNOUNCE_HISTORY; i++)
+    {
+        history[i].key = 0;
+        history[i].time_ms = -1e9;
+    }
+    history_next = 0;
+    last_ms = -1e9;
+}
+
+bool AnnouncementScheduler::said_within(unsigned int key, double now_ms, double interval_ms) const
+{
+    for (int i = 0; i < ANNOUNCE_HISTORY; i++)
+    {
+        if (history[i].key == key && now_ms - history[i].time_ms < interval_ms)
+            return true;
+    }
+    return false;
+}
+
+void AnnouncementScheduler::remember(unsigned int key, double now_ms)
+{
+    // Refresh the entry of the key if there is one, otherwise replace the oldest
+    for (int i = 0; i < ANNOUNCE_HISTORY; i++)
+    {
+        if (history[i].key == key)
+        {
+            history[i].time_ms = now_ms;
+            return;
+        }
+    }
+
+    history[history_next].key = key;
+    history[history_next].time_ms = now_ms;
+    history_next = (history_next + 1) % ANNOUNCE_HISTORY;
+}
+
+bool AnnouncementScheduler::next(const FrameResult& result, double now_ms, std::string& text, bool& urgent)
+{
+    // Closest obstacle ahead in the center column
+    int closest = -1;
+    for (int i = 0; i < result.num_detections; i++)
+    {
+        const FrameDetection& det = result.detections[i];
+        if (det.zone != ZONE_NEAR_CENTER && det.zone != ZONE_MID_CENTER)
+            continue;
+        if (det.distance <= 0.f || det.distance >= urgent_distance)
+            continue;
+        if (closest < 0 || det.distance < result.detections[closest].distance)
+            closest = i;
+    }
+
+    if (closest >= 0)
+    {
+        // Keyed by class and zone, a changing step count alone does not repeat the warning
+        const FrameDetection& det = result.detections[closest];
+        const unsigned int key = 0x80000000u | (det.label << 4) | det.zone;
+        if (!said_within(key, now_ms, urgent_repeat_ms))
+        {
+            frame_object_sentence(det, text);
+            urgent = true;
+            remember(key, now_ms);
+            last_ms = now_ms;
+            return true;
+        }
+    }
+
+    if (now_ms - last_ms < min_gap_ms)
+        return false;
+
+    if (announce_mode == ANNOUNCE_MAXIMAL)
+        frame_max_nav_directions(result, candidates);
+    else
+        frame_min_nav_directions(result, candidates);
+
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        const unsigned int key = sentence_key(candidates[i]) & 0x7fffffffu;
+        if (said_within(key, now_ms, repeat_ms))
+            continue;
+
+        text = candidates[i];
+        urgent = false;
+        remember(key, now_ms);
+        last_ms = now_ms;
+        return true;
+    }
+
+    return false;
+}
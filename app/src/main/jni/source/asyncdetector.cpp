@@ -0,0 +1,202 @@
+// Asynchronous detection on an internal executor thread, see asyncdetector.h
+
+#include "../header/asyncdetector.h"
+
+#include <android/log.h>
+
+#include "benchmark.h"
+
+AsyncDetector::AsyncDetector()
+{
+    stopping = false;
+    num_threads = 1;
+    has_pending = false;
+    running = false;
+    next_id = 0;
+}
+
+AsyncDetector::~AsyncDetector()
+{
+    stop();
+}
+
+void AsyncDetector::set_model(const std::shared_ptr<NanoDet>& _model)
+{
+    std::lock_guard<std::mutex> g(mutex);
+    model = _model;
+}
+
+void AsyncDetector::set_num_threads(int n)
+{
+    std::lock_guard<std::mutex> g(mutex);
+    num_threads = n > 0 ? n : 1;
+}
+
+void AsyncDetector::set_thread_hooks(const std::function<void()>& on_start, const std::function<void()>& on_exit)
+{
+    std::lock_guard<std::mutex> g(mutex);
+    on_thread_start = on_start;
+    on_thread_exit = on_exit;
+}
+
+int AsyncDetector::submit(const cv::Mat& rgb, const AsyncDetectCallback& callback, int heads, const std::vector<int>& find_class_ids)
+{
+    Request cancelled;
+    bool has_cancelled = false;
+    int id;
+    {
+        std::lock_guard<std::mutex> g(mutex);
+
+        id = ++next_id;
+
+        if (stopping)
+        {
+            // A stopped detector runs nothing, the frame is cancelled right away
+            cancelled.id = id;
+            cancelled.callback = callback;
+            has_cancelled = true;
+        }
+        else
+        {
+            // The executor starts with the first frame, detectors that are never used cost no thread
+            if (!executor.joinable())
+                executor = std::thread(&AsyncDetector::run, this);
+
+            if (has_pending)
+            {
+                cancelled = pending;
+                has_cancelled = true;
+            }
+
+            pending.id = id;
+            pending.rgb = rgb;
+            pending.heads = heads;
+            pending.find_class_ids = find_class_ids;
+            pending.callback = callback;
+            has_pending = true;
+        }
+    }
+    wake.notify_one();
+
+    // Callbacks never run under the lock, they may submit again
+    if (has_cancelled && cancelled.callback)
+        cancelled.callback(cancelled.id, ASYNC_DETECT_CANCELLED, std::vector<Object>(), std::vector<Object>(), 0.0);
+
+    return id;
+}
+
+bool AsyncDetector::cancel()
+{
+    Request cancelled;
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        if (!has_pending)
+            return false;
+
+        cancelled = pending;
+        pending = Request();
+        has_pending = false;
+    }
+
+    if (cancelled.callback)
+        cancelled.callback(cancelled.id, ASYNC_DETECT_CANCELLED, std::vector<Object>(), std::vector<Object>(), 0.0);
+
+    return true;
+}
+
+bool AsyncDetector::busy()
+{
+    std::lock_guard<std::mutex> g(mutex);
+    return has_pending || running;
+}
+
+void AsyncDetector::stop()
+{
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+
+    if (executor.joinable() && executor.get_id() != std::this_thread::get_id())
+        executor.join();
+
+    cancel();
+}
+
+void AsyncDetector::run()
+{
+    std::function<void()> on_exit;
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        if (on_thread_start)
+            on_thread_start();
+        on_exit = on_thread_exit;
+    }
+
+    const NanoDet* last_model = 0;
+    std::vector<Object> objects;
+    std::vector<Object> find_objects;
+
+    for (;;)
+    {
+        Request request;
+        std::shared_ptr<NanoDet> request_model;
+        {
+            std::unique_lock<std::mutex> g(mutex);
+            wake.wait(g, [this] { return stopping || has_pending; });
+            if (stopping)
+                break;
+
+            request = pending;
+            pending = Request();
+            has_pending = false;
+            running = true;
+
+            request_model = model;
+            worker.num_threads = num_threads;
+        }
+
+        int status = ASYNC_DETECT_FAILED;
+        double inference_ms = 0.0;
+        objects.clear();
+        find_objects.clear();
+        if (request_model)
+        {
+            // Blob sizes change with the model, start the pools over instead of keeping both sets
+            if (request_model.get() != last_model)
+            {
+                worker.blob_pool_allocator.clear();
+                worker.workspace_pool_allocator.clear();
+                last_model = request_model.get();
+            }
+
+            worker.heads = request.heads;
+
+            double start = ncnn::get_current_time();
+            if (request.find_class_ids.empty())
+                request_model->detect(request.rgb, objects, worker);
+            else
+                request_model->detect_find(request.rgb, request.find_class_ids, objects, find_objects, worker);
+            inference_ms = ncnn::get_current_time() - start;
+            status = ASYNC_DETECT_DONE;
+        }
+
+        // Release the frame before the callback, the caller may reuse its buffer from there
+        request.rgb.release();
+        request_model.reset();
+
+        if (request.callback)
+            request.callback(request.id, status, objects, find_objects, inference_ms);
+
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            running = false;
+        }
+    }
+
+    if (on_exit)
+        on_exit();
+
+    __android_log_print(ANDROID_LOG_DEBUG, "AsyncDetector", "executor stopped");
+}
@@ -0,0 +1,205 @@
+// CPU topology policy for the native pipeline, see cpupolicy.h
+
+#include "../header/cpupolicy.h"
+
+#include <android/log.h>
+#include <algorithm>
+#include <cstdio>
+
+#include "cpu.h"
+
+CpuPolicy::CpuPolicy()
+{
+    min_gain = 0.15f;
+    samples_per_count = 6;
+    reevaluate_ms = 30000.0;
+    drift_tolerance = 0.3f;
+
+    // Topology is queried in reset(), ncnn may not be initialized while globals are constructed
+    big_count = 0;
+    little_count = 0;
+    gpu = false;
+    counts[0] = 1;
+    num_counts = 1;
+    sum_ms[0] = 0.0;
+    num_samples[0] = 0;
+    avg_ms[0] = 0.f;
+    probe = -1;
+    warm_up = false;
+    chosen = 0;
+    settled_time_ms = 0.0;
+    running_ms = 0.f;
+    evaluations = 0;
+    bind_generation = 0;
+}
+
+void CpuPolicy::reset(bool use_gpu)
+{
+    big_count = std::max(1, ncnn::get_big_cpu_count());
+    little_count = ncnn::get_little_cpu_count();
+    gpu = use_gpu;
+
+    // Candidates 1, 2, 4 ... and the full big cluster
+    num_counts = 0;
+    for (int n = 1; n < big_count && num_counts < MAX_COUNTS - 1; n *= 2)
+    {
+        counts[num_counts++] = n;
+    }
+    counts[num_counts++] = big_count;
+
+    for (int i = 0; i < num_counts; i++)
+    {
+        sum_ms[i] = 0.0;
+        num_samples[i] = 0;
+        avg_ms[i] = 0.f;
+    }
+
+    chosen = num_counts - 1;
+    evaluations = 0;
+    settled_time_ms = 0.0;
+    running_ms = 0.f;
+
+    // The GPU does the heavy lifting, thread count only affects the pre and post processing
+    if (gpu)
+        probe = -1;
+    else
+        start_probe();
+
+    bind_generation++;
+
+    __android_log_print(ANDROID_LOG_DEBUG, "CpuPolicy", "big cores %d, little cores %d, gpu %d", big_count, little_count, gpu);
+}
+
+void CpuPolicy::start_probe()
+{
+    for (int i = 0; i < num_counts; i++)
+    {
+        sum_ms[i] = 0.0;
+        num_samples[i] = 0;
+    }
+
+    probe = 0;
+    warm_up = true;
+}
+
+int CpuPolicy::inference_threads() const
+{
+    return counts[probe >= 0 ? probe : chosen];
+}
+
+void CpuPolicy::bind_inference_thread()
+{
+    static thread_local int bound_generation = -1;
+    if (bound_generation == bind_generation)
+        return;
+
+    // Binds the calling thread and as many OpenMP workers as there are big cores
+    int ret = ncnn::set_cpu_thread_affinity(ncnn::get_cpu_thread_affinity_mask(2));
+    if (ret != 0)
+        __android_log_print(ANDROID_LOG_WARN, "CpuPolicy", "Failed to bind inference threads to big cores");
+
+    bound_generation = bind_generation;
+}
+
+LittleCoreScope::LittleCoreScope()
+{
+    restore = false;
+
+    // Nothing to separate on symmetric CPUs
+    if (ncnn::get_little_cpu_count() == 0)
+        return;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &saved) != 0)
+        return;
+
+    const ncnn::CpuSet& mask = ncnn::get_cpu_thread_affinity_mask(1);
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &mask.cpu_set) != 0)
+    {
+        __android_log_print(ANDROID_LOG_WARN, "CpuPolicy", "Failed to bind thread to little cores");
+        return;
+    }
+
+    restore = true;
+}
+
+LittleCoreScope::~LittleCoreScope()
+{
+    if (restore && sched_setaffinity(0, sizeof(cpu_set_t), &saved) != 0)
+        __android_log_print(ANDROID_LOG_WARN, "CpuPolicy", "Failed to restore the thread affinity");
+}
+
+void CpuPolicy::record_inference_time(double ms, double timestamp_ms)
+{
+    if (gpu)
+        return;
+
+    if (probe >= 0)
+    {
+        // The first pass after a thread count change pays for waking up the workers
+        if (warm_up)
+        {
+            warm_up = false;
+            return;
+        }
+
+        sum_ms[probe] += ms;
+        num_samples[probe]++;
+
+        if (num_samples[probe] >= samples_per_count)
+        {
+            avg_ms[probe] = (float)(sum_ms[probe] / num_samples[probe]);
+
+            probe++;
+            warm_up = true;
+            if (probe >= num_counts)
+                settle(timestamp_ms);
+        }
+        return;
+    }
+
+    running_ms += 0.1f * ((float)ms - running_ms);
+
+    const bool expired = timestamp_ms - settled_time_ms >= reevaluate_ms;
+    const bool drifted = running_ms > avg_ms[chosen] * (1.f + drift_tolerance);
+    if (expired || drifted)
+        start_probe();
+}
+
+void CpuPolicy::settle(double timestamp_ms)
+{
+    // Walk up from one thread, moving on only while the next count is clearly faster than the best so far
+    int best = 0;
+    for (int i = 1; i < num_counts; i++)
+    {
+        if (avg_ms[best] >= avg_ms[i] * (1.f + min_gain))
+            best = i;
+    }
+
+    chosen = best;
+    probe = -1;
+    settled_time_ms = timestamp_ms;
+    running_ms = avg_ms[chosen];
+    evaluations++;
+
+    __android_log_print(ANDROID_LOG_DEBUG, "CpuPolicy", "%s", metrics().c_str());
+}
+
+std::string CpuPolicy::metrics() const
+{
+    char buf[128];
+    sprintf(buf, "big=%d little=%d gpu=%d threads=%d evaluations=%d", big_count, little_count, gpu, inference_threads(), evaluations);
+    std::string result = buf;
+
+    // Per count: average forward time and scaling efficiency relative to one thread
+    for (int i = 0; i < num_counts; i++)
+    {
+        if (avg_ms[i] <= 0.f)
+            continue;
+
+        float efficiency = avg_ms[0] > 0.f ? avg_ms[0] / (avg_ms[i] * counts[i]) : 0.f;
+        sprintf(buf, " t%d=%.1fms/%.2f", counts[i], avg_ms[i], efficiency);
+        result += buf;
+    }
+
+    return result;
+}
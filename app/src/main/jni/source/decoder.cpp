@@ -0,0 +1,389 @@
+// Detection head decoders and model manifests, see decoder.h
+
+#include "../header/decoder.h"
+#include "../header/nanodet.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "layer.h"
+
+// Generate bounding box proposal with the class labels and prediction , filtering the the proposals by a probability threshold
+// When class_ids is given only those classes are scored, every other class is ignored
+static void generate_proposals(const ncnn::Mat& cls_pred, const ncnn::Mat& dis_pred, int stride, const ncnn::Mat& in_pad, float prob_threshold, const std::vector<int>* class_ids, std::vector<Object>& objects)
+{
+    const int num_grid = cls_pred.h;
+
+    int num_grid_x;
+    int num_grid_y;
+    if (in_pad.w > in_pad.h)
+    {
+        num_grid_x = in_pad.w / stride;
+        num_grid_y = num_grid / num_grid_x;
+    }
+    else
+    {
+        num_grid_y = in_pad.h / stride;
+        num_grid_x = num_grid / num_grid_y;
+    }
+
+    const int num_class = cls_pred.w;
+    const int reg_max_1 = dis_pred.w / 4;
+
+    for (int i = 0; i < num_grid_y; i++)
+    {
+        for (int j = 0; j < num_grid_x; j++)
+        {
+            const int idx = i * num_grid_x + j;
+
+            const float* scores = cls_pred.row(idx);
+
+            // find label with max score
+            int label = -1;
+            float score = -FLT_MAX;
+            if (class_ids)
+            {
+                for (size_t k = 0; k < class_ids->size(); k++)
+                {
+                    const int c = (*class_ids)[k];
+                    if (c >= 0 && c < num_class && scores[c] > score)
+                    {
+                        label = c;
+                        score = scores[c];
+                    }
+                }
+            }
+            else
+            {
+                for (int k = 0; k < num_class; k++)
+                {
+                    if (scores[k] > score)
+                    {
+                        label = k;
+                        score = scores[k];
+                    }
+                }
+            }
+
+            if (score >= prob_threshold)
+            {
+                ncnn::Mat bbox_pred(reg_max_1, 4, (void*)dis_pred.row(idx));
+                {
+                    ncnn::Layer* softmax = ncnn::create_layer("Softmax");
+
+                    ncnn::ParamDict pd;
+                    pd.set(0, 1); // axis
+                    pd.set(1, 1);
+                    softmax->load_param(pd);
+
+                    ncnn::Option opt;
+                    opt.num_threads = 1;
+                    opt.use_packing_layout = false;
+
+                    softmax->create_pipeline(opt);
+
+                    softmax->forward_inplace(bbox_pred, opt);
+
+                    softmax->destroy_pipeline(opt);
+
+                    delete softmax;
+                }
+
+                float pred_ltrb[4];
+                for (int k = 0; k < 4; k++)
+                {
+                    float dis = 0.f;
+                    const float* dis_after_sm = bbox_pred.row(k);
+                    for (int l = 0; l < reg_max_1; l++)
+                    {
+                        dis += l * dis_after_sm[l];
+                    }
+
+                    pred_ltrb[k] = dis * stride;
+                }
+
+                float pb_cx = (j + 0.5f) * stride;
+                float pb_cy = (i + 0.5f) * stride;
+
+                float x0 = pb_cx - pred_ltrb[0];
+                float y0 = pb_cy - pred_ltrb[1];
+                float x1 = pb_cx + pred_ltrb[2];
+                float y1 = pb_cy + pred_ltrb[3];
+
+                Object obj;
+                obj.rect.x = x0;
+                obj.rect.y = y0;
+                obj.rect.width = x1 - x0;
+                obj.rect.height = y1 - y0;
+                obj.label = label;
+                obj.prob = score;
+
+                objects.push_back(obj);
+            }
+        }
+    }
+}
+
+// Highest scoring class of one anchor, restricted to class_ids when given. Returns -1 if no class can be scored
+static int best_class(const float* scores, int num_class, const std::vector<int>* class_ids, float& score)
+{
+    int label = -1;
+    score = -FLT_MAX;
+    if (class_ids)
+    {
+        for (size_t k = 0; k < class_ids->size(); k++)
+        {
+            const int c = (*class_ids)[k];
+            if (c >= 0 && c < num_class && scores[c] > score)
+            {
+                label = c;
+                score = scores[c];
+            }
+        }
+    }
+    else
+    {
+        for (int k = 0; k < num_class; k++)
+        {
+            if (scores[k] > score)
+            {
+                label = k;
+                score = scores[k];
+            }
+        }
+    }
+    return label;
+}
+
+// Expected value of a distance distribution given as bins, softmax over the bins first
+static float distribution_integral(const float* bins, int num_bins)
+{
+    float max_bin = -FLT_MAX;
+    for (int i = 0; i < num_bins; i++)
+    {
+        max_bin = std::max(max_bin, bins[i]);
+    }
+
+    float sum = 0.f;
+    float weighted = 0.f;
+    for (int i = 0; i < num_bins; i++)
+    {
+        const float e = expf(bins[i] - max_bin);
+        sum += e;
+        weighted += e * i;
+    }
+    return weighted / sum;
+}
+
+static const int decoder_strides[3] = {8, 16, 32};
+static const int decoder_stride_heads[3] = {DETECT_HEAD_STRIDE_8, DETECT_HEAD_STRIDE_16, DETECT_HEAD_STRIDE_32};
+
+// NanoDet-Plus, one classification and one box distribution blob per stride
+class NanoDetPlusDecoder : public HeadDecoder
+{
+public:
+    virtual const char* name() const { return "nanodet-plus"; }
+
+    virtual void decode(ncnn::Extractor& ex, const ncnn::Mat& in_pad, float prob_threshold, const std::vector<int>* class_ids, int heads, std::vector<Object>& proposals) const
+    {
+        static const char* cls_blobs[3] = {"cls_pred_stride_8", "cls_pred_stride_16", "cls_pred_stride_32"};
+        static const char* dis_blobs[3] = {"dis_pred_stride_8", "dis_pred_stride_16", "dis_pred_stride_32"};
+
+        for (int h = 0; h < 3; h++)
+        {
+            if (!(heads & decoder_stride_heads[h]))
+                continue;
+
+            ncnn::Mat cls_pred;
+            ncnn::Mat dis_pred;
+            ex.extract(cls_blobs[h], cls_pred);
+            ex.extract(dis_blobs[h], dis_pred);
+
+            std::vector<Object> objects;
+            generate_proposals(cls_pred, dis_pred, decoder_strides[h], in_pad, prob_threshold, class_ids, objects);
+
+            proposals.insert(proposals.end(), objects.begin(), objects.end());
+        }
+    }
+};
+
+// YOLOX as exported by the ncnn example, one "output" blob with the anchors of all strides in order,
+// sigmoid already applied to objectness and class scores
+class YoloxDecoder : public HeadDecoder
+{
+public:
+    virtual const char* name() const { return "yolox"; }
+
+    virtual void decode(ncnn::Extractor& ex, const ncnn::Mat& in_pad, float prob_threshold, const std::vector<int>* class_ids, int heads, std::vector<Object>& proposals) const
+    {
+        ncnn::Mat out;
+        if (ex.extract("output", out) != 0 || out.w <= 5)
+            return;
+
+        const int num_class = out.w - 5;
+        int anchor = 0;
+        for (int h = 0; h < 3; h++)
+        {
+            const int stride = decoder_strides[h];
+            const int num_grid_x = in_pad.w / stride;
+            const int num_grid_y = in_pad.h / stride;
+
+            // A single output computes every stride, the plan only saves the decoding
+            if (!(heads & decoder_stride_heads[h]))
+            {
+                anchor += num_grid_x * num_grid_y;
+                continue;
+            }
+
+            for (int i = 0; i < num_grid_y; i++)
+            {
+                for (int j = 0; j < num_grid_x; j++, anchor++)
+                {
+                    if (anchor >= out.h)
+                        return;
+
+                    const float* feat = out.row(anchor);
+                    const float objectness = feat[4];
+                    if (objectness < prob_threshold)
+                        continue;
+
+                    float score;
+                    const int label = best_class(feat + 5, num_class, class_ids, score);
+                    if (label < 0 || objectness * score < prob_threshold)
+                        continue;
+
+                    const float cx = (feat[0] + j) * stride;
+                    const float cy = (feat[1] + i) * stride;
+                    const float w = expf(feat[2]) * stride;
+                    const float hgt = expf(feat[3]) * stride;
+
+                    Object obj;
+                    obj.rect.x = cx - w * 0.5f;
+                    obj.rect.y = cy - hgt * 0.5f;
+                    obj.rect.width = w;
+                    obj.rect.height = hgt;
+                    obj.label = label;
+                    obj.prob = objectness * score;
+                    proposals.push_back(obj);
+                }
+            }
+        }
+    }
+};
+
+// YOLOv8 as exported by the ncnn example, one "output0" blob with the anchors of all strides in order,
+// 4 x 16 distance bins followed by the class logits
+class Yolov8Decoder : public HeadDecoder
+{
+public:
+    virtual const char* name() const { return "yolov8"; }
+
+    virtual void decode(ncnn::Extractor& ex, const ncnn::Mat& in_pad, float prob_threshold, const std::vector<int>* class_ids, int heads, std::vector<Object>& proposals) const
+    {
+        const int reg_max = 16;
+
+        ncnn::Mat out;
+        if (ex.extract("output0", out) != 0 || out.w <= 4 * reg_max)
+            return;
+
+        // Compare logits against the threshold instead of taking the sigmoid of every score
+        const float logit_threshold = -logf(1.f / prob_threshold - 1.f);
+
+        const int num_class = out.w - 4 * reg_max;
+        int anchor = 0;
+        for (int h = 0; h < 3; h++)
+        {
+            const int stride = decoder_strides[h];
+            const int num_grid_x = in_pad.w / stride;
+            const int num_grid_y = in_pad.h / stride;
+
+            if (!(heads & decoder_stride_heads[h]))
+            {
+                anchor += num_grid_x * num_grid_y;
+                continue;
+            }
+
+            for (int i = 0; i < num_grid_y; i++)
+            {
+                for (int j = 0; j < num_grid_x; j++, anchor++)
+                {
+                    if (anchor >= out.h)
+                        return;
+
+                    const float* feat = out.row(anchor);
+
+                    float logit;
+                    const int label = best_class(feat + 4 * reg_max, num_class, class_ids, logit);
+                    if (label < 0 || logit < logit_threshold)
+                        continue;
+
+                    const float pb_cx = (j + 0.5f) * stride;
+                    const float pb_cy = (i + 0.5f) * stride;
+                    const float l = distribution_integral(feat, reg_max) * stride;
+                    const float t = distribution_integral(feat + reg_max, reg_max) * stride;
+                    const float r = distribution_integral(feat + 2 * reg_max, reg_max) * stride;
+                    const float b = distribution_integral(feat + 3 * reg_max, reg_max) * stride;
+
+                    Object obj;
+                    obj.rect.x = pb_cx - l;
+                    obj.rect.y = pb_cy - t;
+                    obj.rect.width = l + r;
+                    obj.rect.height = t + b;
+                    obj.label = label;
+                    obj.prob = 1.f / (1.f + expf(-logit));
+                    proposals.push_back(obj);
+                }
+            }
+        }
+    }
+};
+
+const HeadDecoder* head_decoder(int type)
+{
+    static const NanoDetPlusDecoder nanodet_plus;
+    static const YoloxDecoder yolox;
+    static const Yolov8Decoder yolov8;
+
+    switch (type)
+    {
+    case DECODER_NANODET_PLUS:
+        return &nanodet_plus;
+    case DECODER_YOLOX:
+        return &yolox;
+    case DECODER_YOLOV8:
+        return &yolov8;
+    default:
+        return 0;
+    }
+}
+
+// Known models. Only the first one ships in the assets, the others load once their param and bin are added
+static const ModelManifest model_manifests[] = {
+    {"ELite1_416", "nanodet-ELite1_416.param", "nanodet-ELite1_416.bin", DECODER_NANODET_PLUS, 416,
+     {127.f, 127.f, 127.f}, {1.f / 128.f, 1.f / 128.f, 1.f / 128.f}, "input.1", ncnn::Mat::PIXEL_RGB2BGR},
+    {"yolox_nano_416", "yolox-nano.param", "yolox-nano.bin", DECODER_YOLOX, 416,
+     {0.f, 0.f, 0.f}, {1.f, 1.f, 1.f}, "images", ncnn::Mat::PIXEL_RGB2BGR},
+    {"yolov8n_320", "yolov8n.param", "yolov8n.bin", DECODER_YOLOV8, 320,
+     {0.f, 0.f, 0.f}, {1.f / 255.f, 1.f / 255.f, 1.f / 255.f}, "in0", ncnn::Mat::PIXEL_RGB},
+};
+
+int model_manifest_count()
+{
+    return sizeof(model_manifests) / sizeof(model_manifests[0]);
+}
+
+const ModelManifest& model_manifest(int index)
+{
+    return model_manifests[index];
+}
+
+const ModelManifest* find_model_manifest(const char* name)
+{
+    for (int i = 0; i < model_manifest_count(); i++)
+    {
+        if (strcmp(model_manifests[i].name, name) == 0)
+            return &model_manifests[i];
+    }
+    return 0;
+}
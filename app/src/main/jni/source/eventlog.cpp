@@ -0,0 +1,184 @@
+// Delta event stream of the tracked objects, see eventlog.h
+
+#include "../header/eventlog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// One step, as in the tracker announcements
+static const float STEP_METERS = 0.75f;
+
+static int distance_steps(float distance)
+{
+    return distance > 0.f ? (int)(distance / STEP_METERS) : -1;
+}
+
+EventLog::EventLog()
+{
+    for (int i = 0; i < EVENT_LOG_MAX_OBJECTS; i++)
+    {
+        objects[i].track_id = 0;
+        objects[i].seen = false;
+    }
+    next_seq = 1;
+}
+
+void EventLog::append(int type, const DeltaEvent& state, int previous_zone)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    DeltaEvent& event = ring[next_seq % EVENT_LOG_CAPACITY];
+    event = state;
+    event.sequence = next_seq;
+    event.type = type;
+    event.previous_zone = previous_zone;
+    next_seq++;
+}
+
+void EventLog::begin_frame()
+{
+    for (int i = 0; i < EVENT_LOG_MAX_OBJECTS; i++)
+    {
+        objects[i].seen = false;
+    }
+}
+
+void EventLog::observe(int track_id, int label, int zone, float distance)
+{
+    DeltaEvent state;
+    state.track_id = track_id;
+    state.label = label;
+    state.zone = zone;
+    state.distance = distance;
+    state.steps = distance_steps(distance);
+
+    int free_slot = -1;
+    for (int i = 0; i < EVENT_LOG_MAX_OBJECTS; i++)
+    {
+        Followed& o = objects[i];
+        if (o.track_id == 0)
+        {
+            if (free_slot < 0)
+                free_slot = i;
+            continue;
+        }
+        if (o.track_id != track_id)
+            continue;
+
+        o.seen = true;
+
+        if (zone != o.zone)
+        {
+            append(DELTA_ZONE_CHANGE, state, o.zone);
+            o.zone = zone;
+        }
+
+        // Bands move only after a whole step, so a distance wobbling around a band edge stays quiet
+        if (distance > 0.f && (o.band_distance <= 0.f || std::fabs(distance - o.band_distance) >= STEP_METERS))
+        {
+            if (o.band_distance > 0.f)
+                append(DELTA_DISTANCE_BAND, state, zone);
+            o.band_distance = distance;
+        }
+        o.distance = distance;
+        return;
+    }
+
+    // New track, objects beyond the table are not followed
+    if (free_slot < 0)
+        return;
+
+    Followed& o = objects[free_slot];
+    o.track_id = track_id;
+    o.label = label;
+    o.zone = zone;
+    o.distance = distance;
+    o.band_distance = distance;
+    o.seen = true;
+    append(DELTA_ENTER, state, zone);
+}
+
+void EventLog::end_frame()
+{
+    for (int i = 0; i < EVENT_LOG_MAX_OBJECTS; i++)
+    {
+        Followed& o = objects[i];
+        if (o.track_id == 0 || o.seen)
+            continue;
+
+        DeltaEvent state;
+        state.track_id = o.track_id;
+        state.label = o.label;
+        state.zone = o.zone;
+        state.distance = o.distance;
+        state.steps = distance_steps(o.distance);
+        append(DELTA_EXIT, state, o.zone);
+
+        o.track_id = 0;
+    }
+}
+
+void EventLog::clear_objects()
+{
+    begin_frame();
+    end_frame();
+}
+
+unsigned int EventLog::next_sequence() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return next_seq;
+}
+
+int EventLog::read(unsigned int from_sequence, DeltaEvent* events, int max_events, unsigned int& first) const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    // Events older than the ring were overwritten, continue with the oldest one kept
+    const unsigned int oldest = next_seq > EVENT_LOG_CAPACITY ? next_seq - EVENT_LOG_CAPACITY : 1;
+    first = std::max(std::max(from_sequence, oldest), 1u);
+
+    int count = 0;
+    for (unsigned int seq = first; seq < next_seq && count < max_events; seq++)
+    {
+        events[count++] = ring[seq % EVENT_LOG_CAPACITY];
+    }
+    return count;
+}
+
+int EventLog::write(unsigned int from_sequence, void* data, size_t capacity) const
+{
+    if (!data || capacity < EVENT_HEADER_SIZE)
+        return -1;
+
+    DeltaEvent events[EVENT_LOG_CAPACITY];
+    const int max_events = std::min((int)((capacity - EVENT_HEADER_SIZE) / EVENT_RECORD_SIZE), EVENT_LOG_CAPACITY);
+    unsigned int first = 0;
+    const int count = read(from_sequence, events, max_events, first);
+    const unsigned int next = first + count;
+
+    unsigned char* p = (unsigned char*)data;
+    const int version = EVENT_LAYOUT_VERSION;
+    memcpy(p + 0, &version, 4);
+    memcpy(p + 4, &count, 4);
+    memcpy(p + 8, &first, 4);
+    memcpy(p + 12, &next, 4);
+
+    unsigned char* o = p + EVENT_HEADER_SIZE;
+    for (int i = 0; i < count; i++)
+    {
+        const DeltaEvent& e = events[i];
+        memcpy(o + 0, &e.sequence, 4);
+        memcpy(o + 4, &e.type, 4);
+        memcpy(o + 8, &e.track_id, 4);
+        memcpy(o + 12, &e.label, 4);
+        memcpy(o + 16, &e.zone, 4);
+        memcpy(o + 20, &e.previous_zone, 4);
+        memcpy(o + 24, &e.distance, 4);
+        memcpy(o + 28, &e.steps, 4);
+        o += EVENT_RECORD_SIZE;
+    }
+
+    return EVENT_HEADER_SIZE + count * EVENT_RECORD_SIZE;
+}
@@ -0,0 +1,332 @@
+// Structured per-frame result of the detection post-processing, see frameresult.h
+
+#include "../header/frameresult.h"
+#include "../header/nanodet.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+static const char* grid_zone_names[ZONE_COUNT] = {
+        "Far-Left", "Far-Center", "Far-Right",
+        "Mid-Left", "Mid-Center", "Mid-Right",
+        "Near-Left", "Near-Center", "Near-Right"
+};
+
+static const char* nav_direction_texts[] = {
+        "Continue ahead",
+        "Move left",
+        "Move right",
+        "Slow down, no safe path found",
+        "Cannot find path, be careful"
+};
+
+const char* grid_zone_name(int zone)
+{
+    if (zone < 0 || zone >= ZONE_COUNT)
+        return "Out of bounds";
+
+    return grid_zone_names[zone];
+}
+
+const char* nav_direction_text(int direction)
+{
+    if (direction < NAV_CONTINUE_AHEAD || direction > NAV_NO_PATH)
+        return "";
+
+    return nav_direction_texts[direction];
+}
+
+void FrameResult::clear()
+{
+    num_detections = 0;
+    memset(class_counts, 0, sizeof(class_counts));
+    for (int z = 0; z < ZONE_COUNT; z++)
+    {
+        zone_occupied[z] = false;
+        zone_distance[z] = FLT_MAX;
+    }
+    direction = NAV_UNKNOWN;
+    heading = 0.f;
+    heading_width = 0.f;
+    heading_ahead = 0.f;
+    has_surface = false;
+    surface.valid = false;
+    num_tracks = 0;
+}
+
+void FrameResult::begin_frame(double timestamp)
+{
+    clear();
+    sequence++;
+    timestamp_ms = timestamp;
+}
+
+void FrameResult::add_obstacle(int zone, float distance)
+{
+    if (zone < 0 || zone >= ZONE_COUNT)
+        return;
+
+    zone_occupied[zone] = true;
+    zone_distance[zone] = std::min(zone_distance[zone], distance);
+}
+
+FrameResultSnapshots::FrameResultSnapshots()
+        : published(0)
+{
+    for (int i = 0; i < FRAME_SNAPSHOT_SLOTS; i++)
+    {
+        slots[i].clear();
+        slots[i].sequence = 0;
+        slots[i].timestamp_ms = 0.0;
+        readers[i] = 0;
+    }
+}
+
+int FrameResultSnapshots::publish(const FrameResult& result)
+{
+    const int current = published.load();
+    for (int i = 0; i < FRAME_SNAPSHOT_SLOTS; i++)
+    {
+        // A reader pinning this slot after the check sees it unpublished and lets go again
+        if (i == current || readers[i].load() != 0)
+            continue;
+
+        slots[i] = result;
+        published.store(i);
+        return 0;
+    }
+
+    return -1;
+}
+
+unsigned int FrameResultSnapshots::read(FrameResult& result) const
+{
+    for (;;)
+    {
+        const int slot = published.load();
+        readers[slot].fetch_add(1);
+
+        // The writer may have reused the slot between the load and the pin, try the newer one
+        if (published.load() != slot)
+        {
+            readers[slot].fetch_sub(1);
+            continue;
+        }
+
+        result = slots[slot];
+        readers[slot].fetch_sub(1);
+        return result.sequence;
+    }
+}
+
+int analyze_navigation(const FrameResult& result)
+{
+    return analyze_navigation(result.zone_occupied, result.zone_distance);
+}
+
+int analyze_navigation(const bool* zone_occupied, const float* zone_distance)
+{
+    const bool nearCenterFound = zone_occupied[ZONE_NEAR_CENTER];
+    const bool midCenterFound = zone_occupied[ZONE_MID_CENTER];
+    if (!nearCenterFound && !midCenterFound)
+        return NAV_CONTINUE_AHEAD;
+
+    // Unoccupied zones keep FLT_MAX, so they are always farther than the center obstacle
+    const float centerDistance = nearCenterFound ? zone_distance[ZONE_NEAR_CENTER] : zone_distance[ZONE_MID_CENTER];
+    const float nearLeftDistance = zone_distance[ZONE_NEAR_LEFT];
+    const float midLeftDistance = zone_distance[ZONE_MID_LEFT];
+    const float nearRightDistance = zone_distance[ZONE_NEAR_RIGHT];
+    const float midRightDistance = zone_distance[ZONE_MID_RIGHT];
+
+    if (nearLeftDistance > centerDistance && midLeftDistance > centerDistance)
+        return NAV_MOVE_LEFT;
+    if (nearRightDistance > centerDistance && midRightDistance > centerDistance)
+        return NAV_MOVE_RIGHT;
+
+    if (nearLeftDistance <= centerDistance || midLeftDistance <= centerDistance)
+    {
+        if (nearRightDistance <= centerDistance || midRightDistance <= centerDistance)
+            return NAV_SLOW_DOWN;
+        return NAV_MOVE_RIGHT;
+    }
+
+    return NAV_NO_PATH;
+}
+
+// Class labels sorted by name, the order the sentences list the classes in
+static const std::vector<int>& labels_by_name()
+{
+    static const std::vector<int> labels = []() {
+        std::vector<int> sorted(FRAME_MAX_CLASSES);
+        for (int i = 0; i < FRAME_MAX_CLASSES; i++)
+        {
+            sorted[i] = i;
+        }
+        std::sort(sorted.begin(), sorted.end(), [](int a, int b) { return strcmp(nanodet_class_name(a), nanodet_class_name(b)) < 0; });
+        return sorted;
+    }();
+    return labels;
+}
+
+static void append_steps(std::string& text, int steps, bool navigation)
+{
+    char buf[32];
+    if (steps < 1)
+    {
+        text += navigation ? "Less than a step away" : "Stretch out your hand!";
+    }
+    else
+    {
+        sprintf(buf, navigation ? "In %d steps." : "Take %d steps.", steps);
+        text += buf;
+    }
+}
+
+// "<count> <class> detected at <zones>. <steps>" for every class, with the steps of the detection or navigation wording
+static void class_sentences(const FrameResult& result, bool navigation, std::vector<std::string>& sentences)
+{
+    const std::vector<int>& labels = labels_by_name();
+    for (size_t l = 0; l < labels.size(); l++)
+    {
+        const int label = labels[l];
+        if (result.class_counts[label] == 0)
+            continue;
+
+        char buf[64];
+        sprintf(buf, "%d %s detected at ", result.class_counts[label], nanodet_class_name(label));
+        std::string text = buf;
+
+        bool first = true;
+        for (int i = 0; i < result.num_detections; i++)
+        {
+            if (result.detections[i].label != label)
+                continue;
+            if (!first)
+                text += ", ";
+            text += grid_zone_name(result.detections[i].zone);
+            first = false;
+        }
+
+        text += ". ";
+
+        first = true;
+        for (int i = 0; i < result.num_detections; i++)
+        {
+            if (result.detections[i].label != label)
+                continue;
+            if (!first)
+                text += ", ";
+            append_steps(text, result.detections[i].steps, navigation);
+            first = false;
+        }
+
+        sentences.push_back(text);
+    }
+}
+
+void frame_detection_sentences(const FrameResult& result, std::vector<std::string>& sentences)
+{
+    sentences.clear();
+    class_sentences(result, false, sentences);
+}
+
+void frame_object_sentence(const FrameDetection& det, std::string& text)
+{
+    text = std::string("Detected ") + nanodet_class_name(det.label) + " at " + grid_zone_name(det.zone) + ". ";
+    append_steps(text, det.steps, false);
+}
+
+void frame_center_sentences(const FrameResult& result, std::vector<std::string>& sentences)
+{
+    sentences.clear();
+
+    const std::vector<int>& labels = labels_by_name();
+    for (size_t l = 0; l < labels.size(); l++)
+    {
+        const int label = labels[l];
+        if (result.class_counts[label] == 0)
+            continue;
+
+        for (int i = 0; i < result.num_detections; i++)
+        {
+            const FrameDetection& det = result.detections[i];
+            if (det.label != label || (det.zone != ZONE_FAR_CENTER && det.zone != ZONE_MID_CENTER && det.zone != ZONE_NEAR_CENTER))
+                continue;
+
+            std::string text;
+            frame_object_sentence(det, text);
+            sentences.push_back(text);
+        }
+    }
+}
+
+void frame_min_nav_directions(const FrameResult& result, std::vector<std::string>& directions)
+{
+    directions.clear();
+    // No general frame was analyzed yet
+    if (result.direction == NAV_UNKNOWN)
+        return;
+
+    if (result.has_surface)
+        Segmenter::caution_messages(result.surface, directions);
+    directions.push_back(nav_direction_text(result.direction));
+}
+
+void frame_max_nav_directions(const FrameResult& result, std::vector<std::string>& directions)
+{
+    directions.clear();
+    if (result.has_surface)
+        Segmenter::caution_messages(result.surface, directions);
+    class_sentences(result, true, directions);
+}
+
+void frame_track_sentences(const FrameResult& result, std::vector<std::string>& sentences)
+{
+    sentences.clear();
+    for (int t = 0; t < result.num_tracks; t++)
+    {
+        const FrameTrack& track = result.tracks[t];
+        char buf[256];
+        sprintf(buf, "Track %d: %s at %s, %.2f meters", track.id, nanodet_class_name(track.label), grid_zone_name(track.zone), track.distance);
+        sentences.push_back(buf);
+    }
+}
+
+int frame_result_write(const FrameResult& result, void* data, size_t capacity)
+{
+    if (!data || capacity < FRAME_HEADER_SIZE)
+        return -1;
+
+    const int count = std::min(result.num_detections, (int)((capacity - FRAME_HEADER_SIZE) / FRAME_OBJECT_SIZE));
+
+    unsigned char* p = (unsigned char*)data;
+    const int version = FRAME_LAYOUT_VERSION;
+    memcpy(p + 0, &version, 4);
+    memcpy(p + 4, &result.sequence, 4);
+    memcpy(p + 8, &result.timestamp_ms, 8);
+    memcpy(p + 16, &count, 4);
+    memcpy(p + 20, &result.direction, 4);
+
+    unsigned char* o = p + FRAME_HEADER_SIZE;
+    for (int i = 0; i < count; i++)
+    {
+        const FrameDetection& det = result.detections[i];
+        const int label = det.label;
+        const int zone = det.zone;
+        memcpy(o + 0, &label, 4);
+        memcpy(o + 4, &det.prob, 4);
+        memcpy(o + 8, &det.x, 4);
+        memcpy(o + 12, &det.y, 4);
+        memcpy(o + 16, &det.w, 4);
+        memcpy(o + 20, &det.h, 4);
+        memcpy(o + 24, &zone, 4);
+        memcpy(o + 28, &det.distance, 4);
+        memcpy(o + 32, &det.track_id, 4);
+        memcpy(o + 36, &det.steps, 4);
+        o += FRAME_OBJECT_SIZE;
+    }
+
+    return FRAME_HEADER_SIZE + count * FRAME_OBJECT_SIZE;
+}
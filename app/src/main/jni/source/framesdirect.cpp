@@ -8,6 +8,7 @@
 #include <android/log.h>    // Include Android log
 #include <opencv2/imgproc.hpp>
 #include <turbojpeg.h>      // Include libjpeg-turbo
+#include "../header/cpupolicy.h"
 
 // Declare an instance of NdkCamera
 NdkCamera ndkCamera;
@@ -19,6 +20,9 @@ Java_ie_tus_himbavision_jnibridge_FramesDirect_openCamera(JNIEnv* env, jclass /*
 
 extern "C" JNIEXPORT jbyteArray JNICALL
 Java_ie_tus_himbavision_jnibridge_FramesDirect_getLatestFrame(JNIEnv* env, jclass /* this */) {
+    // Encoding is auxiliary work, keep it off the cores running inference until this call returns
+    LittleCoreScope little_cores;
+
     // Get the latest frame
     cv::Mat frame = ndkCamera.get_latest_frame();
 
@@ -0,0 +1,66 @@
+// Ground-contact distance estimate, see groundplane.h
+
+#include "../header/groundplane.h"
+
+#include <cmath>
+
+// Pitch change that rebuilds the table, about half a degree
+static const float PITCH_UPDATE_STEP = 0.01f;
+
+GroundPlane::GroundPlane()
+{
+    camera_height = 1.4f;
+    max_distance = 15.f;
+
+    table_intrinsics.valid = false;
+    table_pitch = 0.f;
+    table_valid = false;
+}
+
+void GroundPlane::update(const CameraIntrinsics& intrinsics, float pitch, bool pitch_valid)
+{
+    if (!intrinsics.valid || !pitch_valid || intrinsics.height <= 0)
+    {
+        table_valid = false;
+        return;
+    }
+
+    const bool same_intrinsics = table_intrinsics.valid
+                                 && table_intrinsics.height == intrinsics.height
+                                 && table_intrinsics.fy == intrinsics.fy
+                                 && table_intrinsics.cy == intrinsics.cy;
+    if (table_valid && same_intrinsics && fabsf(pitch - table_pitch) < PITCH_UPDATE_STEP)
+        return;
+
+    row_distances.resize(intrinsics.height);
+    for (int row = 0; row < intrinsics.height; row++)
+    {
+        // Angle of the ray through the row center below the horizon
+        const float angle = pitch + atanf((row + 0.5f - intrinsics.cy) / intrinsics.fy);
+
+        float distance = -1.f;
+        if (angle > 0.f)
+        {
+            distance = camera_height / tanf(angle);
+            if (distance > max_distance)
+                distance = -1.f;
+        }
+        row_distances[row] = distance;
+    }
+
+    table_intrinsics = intrinsics;
+    table_pitch = pitch;
+    table_valid = true;
+}
+
+float GroundPlane::distance_at_row(float row) const
+{
+    if (!table_valid)
+        return -1.f;
+
+    const int index = (int)row;
+    if (index < 0 || index >= (int)row_distances.size())
+        return -1.f;
+
+    return row_distances[index];
+}
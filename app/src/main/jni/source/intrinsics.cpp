@@ -0,0 +1,117 @@
+// Pinhole intrinsics of the frames fed to the detector, see intrinsics.h
+
+#include "../header/intrinsics.h"
+
+#include <android/log.h>
+
+int camera_stream_intrinsics(const ACameraMetadata* metadata, int stream_w, int stream_h, CameraIntrinsics& intrinsics)
+{
+    intrinsics.valid = false;
+
+    ACameraMetadata_const_entry focal_entry = { 0 };
+    ACameraMetadata_const_entry physical_entry = { 0 };
+    ACameraMetadata_const_entry pixel_array_entry = { 0 };
+    if (ACameraMetadata_getConstEntry(metadata, ACAMERA_LENS_INFO_AVAILABLE_FOCAL_LENGTHS, &focal_entry) != ACAMERA_OK
+        || ACameraMetadata_getConstEntry(metadata, ACAMERA_SENSOR_INFO_PHYSICAL_SIZE, &physical_entry) != ACAMERA_OK
+        || ACameraMetadata_getConstEntry(metadata, ACAMERA_SENSOR_INFO_PIXEL_ARRAY_SIZE, &pixel_array_entry) != ACAMERA_OK)
+    {
+        __android_log_print(ANDROID_LOG_ERROR, "Intrinsics", "Missing lens or sensor characteristics");
+        return -1;
+    }
+
+    const float focal_mm = focal_entry.data.f[0];
+    const float sensor_w_mm = physical_entry.data.f[0];
+    const int pixel_array_w = pixel_array_entry.data.i32[0];
+    if (focal_mm <= 0.f || sensor_w_mm <= 0.f || pixel_array_w <= 0)
+        return -1;
+
+    // Streams are scaled from the active array, which can be smaller than the pixel array
+    int active_w = pixel_array_w;
+    int active_h = pixel_array_entry.data.i32[1];
+    ACameraMetadata_const_entry active_entry = { 0 };
+    if (ACameraMetadata_getConstEntry(metadata, ACAMERA_SENSOR_INFO_ACTIVE_ARRAY_SIZE, &active_entry) == ACAMERA_OK)
+    {
+        // left, top, right, bottom
+        active_w = active_entry.data.i32[2] - active_entry.data.i32[0];
+        active_h = active_entry.data.i32[3] - active_entry.data.i32[1];
+    }
+
+    // The camera crops the active array to the stream aspect ratio around its center before scaling
+    float crop_w = active_w;
+    if ((float)active_w / active_h > (float)stream_w / stream_h)
+        crop_w = (float)active_h * stream_w / stream_h;
+
+    const float focal_sensor_px = focal_mm / sensor_w_mm * pixel_array_w;
+    const float focal_stream_px = focal_sensor_px * stream_w / crop_w;
+
+    intrinsics.width = stream_w;
+    intrinsics.height = stream_h;
+    intrinsics.fx = focal_stream_px;
+    intrinsics.fy = focal_stream_px;
+    intrinsics.cx = stream_w * 0.5f;
+    intrinsics.cy = stream_h * 0.5f;
+    intrinsics.valid = true;
+
+    __android_log_print(ANDROID_LOG_DEBUG, "Intrinsics", "Focal length %.2f mm, sensor %.2f px, stream %dx%d %.2f px", focal_mm, focal_sensor_px, stream_w, stream_h, focal_stream_px);
+
+    return 0;
+}
+
+CameraIntrinsics crop_rotate_intrinsics(const CameraIntrinsics& stream, int x, int y, int w, int h, int rotate_type)
+{
+    CameraIntrinsics out = stream;
+    if (!stream.valid)
+        return out;
+
+    // Principal point inside the crop, the focal length does not change since the crop is not scaled
+    const float px = stream.cx - x;
+    const float py = stream.cy - y;
+
+    out.width = w;
+    out.height = h;
+    out.cx = px;
+    out.cy = py;
+
+    switch (rotate_type)
+    {
+    case 2: // Mirror horizontally
+        out.cx = w - px;
+        break;
+    case 3: // Rotate 180
+        out.cx = w - px;
+        out.cy = h - py;
+        break;
+    case 4: // Mirror vertically
+        out.cy = h - py;
+        break;
+    case 5: // Transpose
+        out.cx = py;
+        out.cy = px;
+        break;
+    case 6: // Rotate 90 clockwise
+        out.cx = h - py;
+        out.cy = px;
+        break;
+    case 7: // Transverse
+        out.cx = h - py;
+        out.cy = w - px;
+        break;
+    case 8: // Rotate 90 counter clockwise
+        out.cx = py;
+        out.cy = w - px;
+        break;
+    default:
+        break;
+    }
+
+    // Types 5 to 8 exchange the image axes
+    if (rotate_type >= 5)
+    {
+        out.width = h;
+        out.height = w;
+        out.fx = stream.fy;
+        out.fy = stream.fx;
+    }
+
+    return out;
+}
@@ -0,0 +1,188 @@
+// Motion and change gate for the detector, see motiongate.h
+
+#include "../header/motiongate.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+MotionGate::MotionGate()
+{
+    enabled = true;
+    change_threshold = 3.0f;
+    motion_threshold = 1;
+    max_skip_frames = 15;
+    max_skip_ms = 500.0;
+
+    last_difference = 0.f;
+    last_motion_x = 0;
+    last_motion_y = 0;
+
+    total_frames = 0;
+    skipped_frames = 0;
+    inference_ms_avg = 0.0;
+    saved_ms_total = 0.0;
+
+    reset();
+}
+
+void MotionGate::reset()
+{
+    has_keyframe = false;
+    skipped_in_a_row = 0;
+    keyframe_time_ms = 0.0;
+}
+
+// Average blocks of the Y plane into the grid, sampling at most 8x8 pixels per block
+void MotionGate::downsample(const unsigned char* y, int width, int height, int stride, unsigned char* grid) const
+{
+    const int cell_w = width / GRID_W;
+    const int cell_h = height / GRID_H;
+    const int step_x = std::max(1, cell_w / 8);
+    const int step_y = std::max(1, cell_h / 8);
+
+    for (int gy = 0; gy < GRID_H; gy++)
+    {
+        for (int gx = 0; gx < GRID_W; gx++)
+        {
+            const unsigned char* block = y + gy * cell_h * stride + gx * cell_w;
+
+            int sum = 0;
+            int count = 0;
+            for (int row = 0; row < cell_h; row += step_y)
+            {
+                const unsigned char* p = block + row * stride;
+                for (int col = 0; col < cell_w; col += step_x)
+                {
+                    sum += p[col];
+                    count++;
+                }
+            }
+
+            grid[gy * GRID_W + gx] = count ? (unsigned char)(sum / count) : 0;
+        }
+    }
+}
+
+float MotionGate::shifted_difference(int dx, int dy) const
+{
+    const int x0 = std::max(0, -dx);
+    const int x1 = std::min((int)GRID_W, GRID_W - dx);
+    const int y0 = std::max(0, -dy);
+    const int y1 = std::min((int)GRID_H, GRID_H - dy);
+
+    // Remove the global brightness change first so auto exposure does not count as a scene change
+    int sum_current = 0;
+    int sum_keyframe = 0;
+    for (int gy = y0; gy < y1; gy++)
+    {
+        const unsigned char* c = current + (gy + dy) * GRID_W + dx;
+        const unsigned char* k = keyframe + gy * GRID_W;
+        for (int gx = x0; gx < x1; gx++)
+        {
+            sum_current += c[gx];
+            sum_keyframe += k[gx];
+        }
+    }
+
+    const int count = (x1 - x0) * (y1 - y0);
+    if (count <= 0)
+        return 255.f;
+
+    const int offset = (sum_current - sum_keyframe) / count;
+
+    int sad = 0;
+    for (int gy = y0; gy < y1; gy++)
+    {
+        const unsigned char* c = current + (gy + dy) * GRID_W + dx;
+        const unsigned char* k = keyframe + gy * GRID_W;
+        for (int gx = x0; gx < x1; gx++)
+        {
+            sad += std::abs((int)c[gx] - (int)k[gx] - offset);
+        }
+    }
+
+    return (float)sad / count;
+}
+
+bool MotionGate::update(const unsigned char* y, int width, int height, int stride, double timestamp_ms)
+{
+    total_frames++;
+
+    if (!enabled || !y || width < GRID_W || height < GRID_H)
+    {
+        has_keyframe = false;
+        return true;
+    }
+
+    downsample(y, width, height, stride, current);
+
+    bool run_inference = true;
+    if (has_keyframe)
+    {
+        // Coarse global motion: the shift that best aligns the current grid with the keyframe
+        float best = shifted_difference(0, 0);
+        int best_dx = 0;
+        int best_dy = 0;
+        for (int dy = -SEARCH; dy <= SEARCH; dy++)
+        {
+            for (int dx = -SEARCH; dx <= SEARCH; dx++)
+            {
+                if (dx == 0 && dy == 0)
+                    continue;
+
+                float d = shifted_difference(dx, dy);
+                if (d < best)
+                {
+                    best = d;
+                    best_dx = dx;
+                    best_dy = dy;
+                }
+            }
+        }
+
+        last_difference = best;
+        last_motion_x = best_dx;
+        last_motion_y = best_dy;
+
+        const bool camera_moved = std::abs(best_dx) >= motion_threshold || std::abs(best_dy) >= motion_threshold;
+        const bool scene_changed = best >= change_threshold;
+        const bool too_long = skipped_in_a_row >= max_skip_frames || timestamp_ms - keyframe_time_ms >= max_skip_ms;
+
+        run_inference = camera_moved || scene_changed || too_long;
+    }
+
+    if (run_inference)
+    {
+        memcpy(keyframe, current, sizeof(keyframe));
+        has_keyframe = true;
+        keyframe_time_ms = timestamp_ms;
+        skipped_in_a_row = 0;
+    }
+    else
+    {
+        skipped_in_a_row++;
+        skipped_frames++;
+        saved_ms_total += inference_ms_avg;
+    }
+
+    return run_inference;
+}
+
+void MotionGate::record_inference_time(double ms)
+{
+    if (inference_ms_avg == 0.0)
+        inference_ms_avg = ms;
+    else
+        inference_ms_avg += 0.1 * (ms - inference_ms_avg);
+}
+
+float MotionGate::skip_rate() const
+{
+    return total_frames ? (float)skipped_frames / total_frames : 0.f;
+}
+
+double MotionGate::saved_ms() const
+{
+    return saved_ms_total;
+}
@@ -26,13 +26,22 @@
  */
 
 #include "../header/nanodet.h" //Header files, contains class declarations
-#include "../header/ndkcamera.h"
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp> //OpenCV libraries for image processing
 
 #include "cpu.h" //handles CPU configurations for performance optimization
+#include "benchmark.h" //ncnn::get_current_time for tracker timestamps and load timings
 #include <map>
 #include <string>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <atomic>
+#include <thread>
+
+#if NCNN_VULKAN
+#include "pipelinecache.h" //Vulkan pipeline cache shared across model loads
+#endif
 
 //Calculate the area of intersection between two bounding boxes a and b
 static inline float intersection_area(const Object& a, const Object& b)
@@ -131,123 +140,126 @@ static void nms_sorted_bboxes(const std::vector<Object>& faceobjects, std::vecto
     }
 }
 
-// Generate bounding box proposal with the class labels and prediction , filtering the the proposals by a probability threshold
-static void generate_proposals(const ncnn::Mat& cls_pred, const ncnn::Mat& dis_pred, int stride, const ncnn::Mat& in_pad, float prob_threshold, std::vector<Object>& objects)
-{
-    const int num_grid = cls_pred.h;
-
-    int num_grid_x;
-    int num_grid_y;
-    if (in_pad.w > in_pad.h)
-    {
-        num_grid_x = in_pad.w / stride;
-        num_grid_y = num_grid / num_grid_x;
-    }
-    else
-    {
-        num_grid_y = in_pad.h / stride;
-        num_grid_x = num_grid / num_grid_y;
-    }
-
-    const int num_class = cls_pred.w;
-    const int reg_max_1 = dis_pred.w / 4;
 
-    for (int i = 0; i < num_grid_y; i++)
-    {
-        for (int j = 0; j < num_grid_x; j++)
-        {
-            const int idx = i * num_grid_x + j;
-
-            const float* scores = cls_pred.row(idx);
-
-            // find label with max score
-            int label = -1;
-            float score = -FLT_MAX;
-            for (int k = 0; k < num_class; k++)
-            {
-                if (scores[k] > score)
-                {
-                    label = k;
-                    score = scores[k];
-                }
-            }
-
-            if (score >= prob_threshold)
-            {
-                ncnn::Mat bbox_pred(reg_max_1, 4, (void*)dis_pred.row(idx));
-                {
-                    ncnn::Layer* softmax = ncnn::create_layer("Softmax");
-
-                    ncnn::ParamDict pd;
-                    pd.set(0, 1); // axis
-                    pd.set(1, 1);
-                    softmax->load_param(pd);
+int detect_mode_heads(int mode)
+{
+    // Objects only found by the stride 8 head are a few pixels tall and far beyond the near and mid rows
+    if (mode == DETECT_MODE_NAVIGATION)
+        return DETECT_HEAD_STRIDE_16 | DETECT_HEAD_STRIDE_32;
 
-                    ncnn::Option opt;
-                    opt.num_threads = 1;
-                    opt.use_packing_layout = false;
+    return DETECT_HEAD_ALL;
+}
 
-                    softmax->create_pipeline(opt);
+// Apply nms to the proposals of one image and map the kept boxes back to the original image
+// (x_offset, y_offset) is where the resized image starts in the network input and scale its resize factor
+static void finalize_objects(std::vector<Object>& proposals, std::vector<Object>& objects, float nms_threshold, float scale, int x_offset, int y_offset, int width, int height)
+{
+    // sort all proposals by score from highest to lowest
+    qsort_descent_inplace(proposals);
 
-                    softmax->forward_inplace(bbox_pred, opt);
+    // apply nms with nms_threshold
+    std::vector<int> picked;
+    nms_sorted_bboxes(proposals, picked, nms_threshold);
 
-                    softmax->destroy_pipeline(opt);
+    int count = picked.size();
 
-                    delete softmax;
-                }
+    objects.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        objects[i] = proposals[picked[i]];
 
-                float pred_ltrb[4];
-                for (int k = 0; k < 4; k++)
-                {
-                    float dis = 0.f;
-                    const float* dis_after_sm = bbox_pred.row(k);
-                    for (int l = 0; l < reg_max_1; l++)
-                    {
-                        dis += l * dis_after_sm[l];
-                    }
+        // adjust offset to original unpadded
+        float x0 = (objects[i].rect.x - x_offset) / scale;
+        float y0 = (objects[i].rect.y - y_offset) / scale;
+        float x1 = (objects[i].rect.x + objects[i].rect.width - x_offset) / scale;
+        float y1 = (objects[i].rect.y + objects[i].rect.height - y_offset) / scale;
 
-                    pred_ltrb[k] = dis * stride;
-                }
+        // clip
+        x0 = std::max(std::min(x0, (float)(width - 1)), 0.f);
+        y0 = std::max(std::min(y0, (float)(height - 1)), 0.f);
+        x1 = std::max(std::min(x1, (float)(width - 1)), 0.f);
+        y1 = std::max(std::min(y1, (float)(height - 1)), 0.f);
 
-                float pb_cx = (j + 0.5f) * stride;
-                float pb_cy = (i + 0.5f) * stride;
+        objects[i].rect.x = x0;
+        objects[i].rect.y = y0;
+        objects[i].rect.width = x1 - x0;
+        objects[i].rect.height = y1 - y0;
+    }
 
-                float x0 = pb_cx - pred_ltrb[0];
-                float y0 = pb_cy - pred_ltrb[1];
-                float x1 = pb_cx + pred_ltrb[2];
-                float y1 = pb_cy + pred_ltrb[3];
+    // sort objects by area
+    struct
+    {
+        bool operator()(const Object& a, const Object& b) const
+        {
+            return a.rect.area() > b.rect.area();
+        }
+    } objects_area_greater;
+    std::sort(objects.begin(), objects.end(), objects_area_greater);
+}
 
-                Object obj;
-                obj.rect.x = x0;
-                obj.rect.y = y0;
-                obj.rect.width = x1 - x0;
-                obj.rect.height = y1 - y0;
-                obj.label = label;
-                obj.prob = score;
+#if NCNN_VULKAN
+// Shared by every load so compiled shader pipelines survive a model reload within the process. ncnn keeps the
+// pipelines in memory only, a new process compiles them again. Created on first use, loads run on
+// background threads so the initialization must be thread-safe, a function-local static is
+static ncnn::PipelineCache* shared_pipeline_cache()
+{
+    static ncnn::PipelineCache* cache = new ncnn::PipelineCache(ncnn::get_gpu_device());
+    return cache;
+}
+#endif
 
-                objects.push_back(obj);
-            }
-        }
-    }
+DetectWorker::DetectWorker()
+        : num_threads(1),
+          heads(DETECT_HEAD_ALL)
+{
+    blob_pool_allocator.set_size_compare_ratio(0.f);
+    workspace_pool_allocator.set_size_compare_ratio(0.f);
 }
 
 NanoDet::NanoDet()
-        : focalLengthPx(0.0f),
-          focalLengthInitialized(false)
+        : num_threads(0),
+          outputHeads(DETECT_HEAD_ALL),
+          decoder(head_decoder(DECODER_NANODET_PLUS)),
+          inputBlob("input.1"),
+          pixelType(ncnn::Mat::PIXEL_RGB2BGR),
+          surfaceZones(0),
+          model_asset(0),
+          modelZeroCopy(false),
+          modelLoadMs(0.0),
+          warmUpMs(0.0),
+          roiRedetection(false),
+          roiPassesSinceFull(0),
+          fullPasses(0),
+          roiPasses(0),
+          fullPassMs(0.0),
+          roiPassMs(0.0),
+          trackerRunning(false)
 {
+    cameraIntrinsics.valid = false;
+    cameraPitch = 0.f;
+    cameraPitchValid = false;
+
     blob_pool_allocator.set_size_compare_ratio(0.f);
     workspace_pool_allocator.set_size_compare_ratio(0.f);
+    clear_last_known_zones();
+}
+
+NanoDet::~NanoDet()
+{
+    // The net may reference weights inside the asset mapping, release it first
+    nanodet.clear();
+    release_model_asset();
 }
 
 
 int NanoDet::load(const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
 {
     nanodet.clear();
+    release_model_asset();
     blob_pool_allocator.clear();
     workspace_pool_allocator.clear();
 
-    ncnn::set_cpu_powersave(2);
-    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+    // Thread placement is applied by the render thread through CpuPolicy, binding here would pin the JNI caller
 
     nanodet.opt = ncnn::Option();
 
@@ -267,6 +279,10 @@ int NanoDet::load(const char* modeltype, int _target_size, const float* _mean_va
     nanodet.load_param(parampath);
     nanodet.load_model(modelpath);
 
+    decoder = head_decoder(DECODER_NANODET_PLUS);
+    inputBlob = "input.1";
+    pixelType = ncnn::Mat::PIXEL_RGB2BGR;
+
     target_size = _target_size;
     mean_vals[0] = _mean_vals[0];
     mean_vals[1] = _mean_vals[1];
@@ -280,43 +296,207 @@ int NanoDet::load(const char* modeltype, int _target_size, const float* _mean_va
 
 int NanoDet::load(AAssetManager* mgr, const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
 {
+    char parampath[256];
+    char modelpath[256];
+    sprintf(parampath, "nanodet-%s.param", modeltype);
+    sprintf(modelpath, "nanodet-%s.bin", modeltype);
+
+    ModelManifest manifest = {modeltype, parampath, modelpath, DECODER_NANODET_PLUS, _target_size,
+                              {_mean_vals[0], _mean_vals[1], _mean_vals[2]}, {_norm_vals[0], _norm_vals[1], _norm_vals[2]},
+                              "input.1", ncnn::Mat::PIXEL_RGB2BGR};
+    return load(mgr, manifest, use_gpu);
+}
+
+int NanoDet::load(AAssetManager* mgr, const ModelManifest& manifest, bool use_gpu)
+{
+    if (!head_decoder(manifest.decoder))
+        return -1;
+
+    const char* modeltype = manifest.name;
+    const char* parampath = manifest.param_path;
+    const char* modelpath = manifest.model_path;
+
+    double start = ncnn::get_current_time();
+
+    ncnn::Option opt;
+
+#if NCNN_VULKAN
+    opt.use_vulkan_compute = use_gpu;
+#endif
+
+    opt.num_threads = ncnn::get_big_cpu_count();
+    opt.blob_allocator = &blob_pool_allocator;
+    opt.workspace_allocator = &workspace_pool_allocator;
+
+#if NCNN_VULKAN
+    if (use_gpu)
+    {
+        opt.pipeline_cache = shared_pipeline_cache();
+    }
+#endif
+
+    AAsset* param_asset = AAssetManager_open(mgr, parampath, AASSET_MODE_BUFFER);
+    AAsset* new_model_asset = AAssetManager_open(mgr, modelpath, AASSET_MODE_BUFFER);
+    const char* param_buffer = param_asset ? (const char*)AAsset_getBuffer(param_asset) : 0;
+    const unsigned char* model_buffer = new_model_asset ? (const unsigned char*)AAsset_getBuffer(new_model_asset) : 0;
+
     nanodet.clear();
+    release_model_asset();
     blob_pool_allocator.clear();
     workspace_pool_allocator.clear();
 
-    ncnn::set_cpu_powersave(2);
-    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+    // Thread placement is applied by the render thread through CpuPolicy, binding here would pin the JNI caller
 
-    nanodet.opt = ncnn::Option();
+    nanodet.opt = opt;
 
-#if NCNN_VULKAN
-    nanodet.opt.use_vulkan_compute = use_gpu;
-#endif
+    // The param text is small, copy it once to get the null terminated string load_param_mem expects
+    int ret;
+    if (param_buffer)
+    {
+        std::string param_text(param_buffer, AAsset_getLength(param_asset));
+        ret = nanodet.load_param_mem(param_text.c_str());
+    }
+    else
+    {
+        ret = nanodet.load_param(mgr, parampath);
+    }
+    if (param_asset)
+        AAsset_close(param_asset);
 
-    nanodet.opt.num_threads = ncnn::get_big_cpu_count();
-    nanodet.opt.blob_allocator = &blob_pool_allocator;
-    nanodet.opt.workspace_allocator = &workspace_pool_allocator;
+    if (ret != 0)
+    {
+        // Manifests may list models whose assets are not bundled
+        __android_log_print(ANDROID_LOG_WARN, "NanoDet", "Model %s not available", modeltype);
+        if (new_model_asset)
+            AAsset_close(new_model_asset);
+        nanodet.clear();
+        return -1;
+    }
 
-    char parampath[256];
-    char modelpath[256];
-    sprintf(parampath, "nanodet-%s.param", modeltype);
-    sprintf(modelpath, "nanodet-%s.bin", modeltype);
+    // Reference the weights in place when the asset is stored uncompressed and mapped from the apk,
+    // the asset stays open until the next load so the mapping outlives the net
+    modelZeroCopy = false;
+    model_asset = new_model_asset;
+    if (model_buffer && ((size_t)model_buffer & 3) == 0 && nanodet.load_model(model_buffer) > 0)
+    {
+        modelZeroCopy = true;
+    }
+    else
+    {
+        // Compressed or misaligned asset, let ncnn stream and copy the weights
+        release_model_asset();
+        if (nanodet.load_model(mgr, modelpath) != 0)
+        {
+            __android_log_print(ANDROID_LOG_WARN, "NanoDet", "Weights of model %s not available", modeltype);
+            nanodet.clear();
+            return -1;
+        }
+    }
 
-    nanodet.load_param(mgr, parampath);
-    nanodet.load_model(mgr, modelpath);
+    apply_manifest(manifest);
 
-    target_size = _target_size;
-    mean_vals[0] = _mean_vals[0];
-    mean_vals[1] = _mean_vals[1];
-    mean_vals[2] = _mean_vals[2];
-    norm_vals[0] = _norm_vals[0];
-    norm_vals[1] = _norm_vals[1];
-    norm_vals[2] = _norm_vals[2];
+    modelLoadMs = ncnn::get_current_time() - start;
+
+    // Pay the first inference costs now instead of on the first camera frame
+    warm_up();
+
+    __android_log_print(ANDROID_LOG_DEBUG, "NanoDet", "Model %s built in %.1f ms (zero copy %d), warm-up %.1f ms",
+                        modeltype, modelLoadMs, modelZeroCopy, warmUpMs);
 
     return 0;
 }
 
+void NanoDet::apply_manifest(const ModelManifest& manifest)
+{
+    decoder = head_decoder(manifest.decoder);
+    inputBlob = manifest.input_blob;
+    pixelType = manifest.pixel_type;
+    target_size = manifest.target_size;
+    mean_vals[0] = manifest.mean_vals[0];
+    mean_vals[1] = manifest.mean_vals[1];
+    mean_vals[2] = manifest.mean_vals[2];
+    norm_vals[0] = manifest.norm_vals[0];
+    norm_vals[1] = manifest.norm_vals[1];
+    norm_vals[2] = manifest.norm_vals[2];
+}
+
+int NanoDet::warm_up()
+{
+    double start = ncnn::get_current_time();
+
+    // Mid grey portrait frame shaped like the cropped camera frames, so the allocators settle on real blob sizes
+    cv::Mat rgb(target_size, target_size * 3 / 4, CV_8UC3, cv::Scalar(127, 127, 127));
+    std::vector<Object> objects;
+    int ret = detect(rgb, objects);
+
+    warmUpMs = ncnn::get_current_time() - start;
+    return ret;
+}
+
+void NanoDet::release_model_asset()
+{
+    if (model_asset)
+    {
+        AAsset_close(model_asset);
+        model_asset = 0;
+    }
+}
+
 int NanoDet::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    return detect_impl(rgb, objects, prob_threshold, nms_threshold, 0, 0.f, 0, 0.f, 0);
+}
+
+int NanoDet::detect(const cv::Mat& rgb, std::vector<Object>& objects, DetectWorker& worker, float prob_threshold, float nms_threshold) const
+{
+    return detect_impl(rgb, objects, prob_threshold, nms_threshold, &worker, 0.f, 0, 0.f, 0);
+}
+
+int NanoDet::detect_parallel(const std::vector<cv::Mat>& frames, std::vector<std::vector<Object> >& results, DetectWorker* workers, int num_workers, float prob_threshold, float nms_threshold) const
+{
+    const int n = frames.size();
+    results.resize(n);
+    if (n == 0 || num_workers <= 0)
+        return n == 0 ? 0 : -1;
+
+    // Frames are handed out one at a time so a slow frame does not hold back a fixed share
+    std::atomic<int> next(0);
+    auto run = [&](DetectWorker* worker) {
+        for (int i = next++; i < n; i = next++)
+        {
+            detect_impl(frames[i], results[i], prob_threshold, nms_threshold, worker, 0.f, 0, 0.f, 0);
+        }
+    };
+
+    // The calling thread is the last worker
+    const int num_threads = std::min(num_workers, n);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads - 1; t++)
+    {
+        threads.push_back(std::thread(run, &workers[t]));
+    }
+    run(&workers[num_threads - 1]);
+
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+        threads[t].join();
+    }
+
+    return 0;
+}
+
+int NanoDet::detect_find(const cv::Mat& rgb, const std::vector<int>& class_ids, std::vector<Object>& objects, std::vector<Object>& find_objects, float prob_threshold, float find_prob_threshold, float nms_threshold)
+{
+    return detect_impl(rgb, objects, prob_threshold, nms_threshold, 0, 0.f, &class_ids, find_prob_threshold, &find_objects);
+}
+
+int NanoDet::detect_find(const cv::Mat& rgb, const std::vector<int>& class_ids, std::vector<Object>& objects, std::vector<Object>& find_objects, DetectWorker& worker, float prob_threshold, float find_prob_threshold, float nms_threshold) const
+{
+    return detect_impl(rgb, objects, prob_threshold, nms_threshold, &worker, 0.f, &class_ids, find_prob_threshold, &find_objects);
+}
+
+int NanoDet::detect_impl(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold, DetectWorker* worker, float input_scale,
+                         const std::vector<int>* find_class_ids, float find_prob_threshold, std::vector<Object>* find_objects) const
 {
     int width = rgb.cols;
     int height = rgb.rows;
@@ -325,7 +505,13 @@ int NanoDet::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob
     int w = width;
     int h = height;
     float scale = 1.f;
-    if (w > h)
+    if (input_scale > 0.f)
+    {
+        scale = input_scale;
+        w = std::max(1, (int)(w * scale));
+        h = std::max(1, (int)(h * scale));
+    }
+    else if (w > h)
     {
         scale = (float)target_size / w;
         w = target_size;
@@ -338,7 +524,8 @@ int NanoDet::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob
         w = w * scale;
     }
 
-    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB2BGR, width, height, w, h);
+    // The stride lets crops be passed as views into the camera frame
+    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, pixelType, width, height, (int)rgb.step[0], w, h);
 
     // pad to target_size rectangle
     int wpad = (w + 31) / 32 * 32 - w;
@@ -348,96 +535,220 @@ int NanoDet::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob
 
     in_pad.substract_mean_normalize(mean_vals, norm_vals);
 
+    // create_extractor only reads the net, everything an extractor writes goes through its allocators
     ncnn::Extractor ex = nanodet.create_extractor();
+    std::vector<Object> local_proposals;
+    std::vector<Object>& proposals = worker ? worker->proposals : local_proposals;
+    if (worker)
+    {
+        ex.set_blob_allocator(&worker->blob_pool_allocator);
+        ex.set_workspace_allocator(&worker->workspace_pool_allocator);
+        ex.set_num_threads(worker->num_threads);
+        proposals.clear();
+    }
+    else if (num_threads > 0)
+    {
+        ex.set_num_threads(num_threads);
+    }
 
-    ex.input("input.1", in_pad);
+    ex.input(inputBlob.c_str(), in_pad);
 
-    std::vector<Object> proposals;
+    decoder->decode(ex, in_pad, prob_threshold, 0, worker ? worker->heads : outputHeads, proposals);
 
-    // stride 8
-    {
-        ncnn::Mat cls_pred;
-        ncnn::Mat dis_pred;
-        ex.extract("cls_pred_stride_8", cls_pred);
-        ex.extract("dis_pred_stride_8", dis_pred);
+    finalize_objects(proposals, objects, nms_threshold, scale, wpad / 2, hpad / 2, width, height);
 
-        std::vector<Object> objects8;
-        generate_proposals(cls_pred, dis_pred, 8, in_pad, prob_threshold, objects8);
+    // The find query is decoded a second time from the same outputs, the extractor keeps the blobs it already computed.
+    // Every head is decoded since the query looks for objects of any size
+    if (find_objects)
+    {
+        std::vector<Object> find_proposals;
+        if (find_class_ids && !find_class_ids->empty())
+            decoder->decode(ex, in_pad, find_prob_threshold, find_class_ids, DETECT_HEAD_ALL, find_proposals);
 
-        proposals.insert(proposals.end(), objects8.begin(), objects8.end());
+        finalize_objects(find_proposals, *find_objects, nms_threshold, scale, wpad / 2, hpad / 2, width, height);
     }
 
-    // stride 16
-    {
-        ncnn::Mat cls_pred;
-        ncnn::Mat dis_pred;
-        ex.extract("cls_pred_stride_16", cls_pred);
-        ex.extract("dis_pred_stride_16", dis_pred);
+    return 0;
+}
 
-        std::vector<Object> objects16;
-        generate_proposals(cls_pred, dis_pred, 16, in_pad, prob_threshold, objects16);
+// ROI-guided re-detection tuning
+static const float ROI_PADDING = 0.5f;          // Context added on every side, relative to the box size
+static const int ROI_MIN_INPUT = 64;            // Smallest crop side at network input, smaller crops are upscaled
+static const int ROI_FULL_FRAME_INTERVAL = 5;   // Crop passes between two full-frame passes
+static const int ROI_MAX_TRACKS = 6;            // More tracks than this run the full frame
+static const float ROI_MAX_AREA_SHARE = 0.5f;   // Crop inputs summing to more than this share of the full-frame input run the full frame
+static const float ROI_MATCH_IOU = 0.3f;        // Overlap with the predicted box for a re-detection to count as its track
 
-        proposals.insert(proposals.end(), objects16.begin(), objects16.end());
+// Remove duplicates found by overlapping crops and order the objects like detect() does
+static void merge_objects(std::vector<Object>& objects, float nms_threshold)
+{
+    qsort_descent_inplace(objects);
+
+    std::vector<int> picked;
+    nms_sorted_bboxes(objects, picked, nms_threshold);
+
+    std::vector<Object> merged(picked.size());
+    for (size_t i = 0; i < picked.size(); i++)
+    {
+        merged[i] = objects[picked[i]];
     }
 
-    // stride 32
+    struct
     {
-        ncnn::Mat cls_pred;
-        ncnn::Mat dis_pred;
-        ex.extract("cls_pred_stride_32", cls_pred);
-        ex.extract("dis_pred_stride_32", dis_pred);
+        bool operator()(const Object& a, const Object& b) const
+        {
+            return a.rect.area() > b.rect.area();
+        }
+    } objects_area_greater;
+    std::sort(merged.begin(), merged.end(), objects_area_greater);
 
-        std::vector<Object> objects32;
-        generate_proposals(cls_pred, dis_pred, 32, in_pad, prob_threshold, objects32);
+    objects.swap(merged);
+}
 
-        proposals.insert(proposals.end(), objects32.begin(), objects32.end());
-    }
+// Pixels of the frame detect_rois() runs through the network for one region, empty if the region is off the frame
+static cv::Rect roi_crop(const cv::Rect_<float>& roi, int cols, int rows)
+{
+    cv::Rect_<float> padded(roi.x - roi.width * ROI_PADDING, roi.y - roi.height * ROI_PADDING,
+                            roi.width * (1.f + 2 * ROI_PADDING), roi.height * (1.f + 2 * ROI_PADDING));
+    cv::Rect crop = padded & cv::Rect_<float>(0.f, 0.f, (float)cols, (float)rows);
+    return crop & cv::Rect(0, 0, cols, rows);
+}
 
-    // sort all proposals by score from highest to lowest
-    qsort_descent_inplace(proposals);
+// Scale detect_rois() resizes a crop with, the one of a full-frame pass unless the crop would end up too small
+static float roi_scale(const cv::Rect& crop, float full_scale)
+{
+    return std::max(full_scale, (float)ROI_MIN_INPUT / std::max(crop.width, crop.height));
+}
 
-    // apply nms with nms_threshold
-    std::vector<int> picked;
-    nms_sorted_bboxes(proposals, picked, nms_threshold);
+// Network input of a pass over width x height pixels at scale, padded to a multiple of 32 like detect_impl() does
+static float padded_input_area(int width, int height, float scale)
+{
+    const int w = std::max(1, (int)(width * scale));
+    const int h = std::max(1, (int)(height * scale));
+    return (float)((w + 31) / 32 * 32) * (float)((h + 31) / 32 * 32);
+}
 
-    int count = picked.size();
+int NanoDet::detect_rois(const cv::Mat& rgb, const std::vector<cv::Rect_<float> >& rois, std::vector<Object>& objects, std::vector<int>& lost, float prob_threshold, float nms_threshold)
+{
+    objects.clear();
+    lost.clear();
 
-    objects.resize(count);
-    for (int i = 0; i < count; i++)
+    const float full_scale = (float)target_size / std::max(rgb.cols, rgb.rows);
+
+    std::vector<Object> crop_objects;
+    for (size_t i = 0; i < rois.size(); i++)
     {
-        objects[i] = proposals[picked[i]];
+        const cv::Rect_<float>& roi = rois[i];
+        const cv::Rect crop = roi_crop(roi, rgb.cols, rgb.rows);
+        if (crop.width < 2 || crop.height < 2)
+        {
+            lost.push_back(i);
+            continue;
+        }
 
-        // adjust offset to original unpadded
-        float x0 = (objects[i].rect.x - (wpad / 2)) / scale;
-        float y0 = (objects[i].rect.y - (hpad / 2)) / scale;
-        float x1 = (objects[i].rect.x + objects[i].rect.width - (wpad / 2)) / scale;
-        float y1 = (objects[i].rect.y + objects[i].rect.height - (hpad / 2)) / scale;
+        // Keep the object at the size the network sees in a full-frame pass, so the crop costs in proportion to the object.
+        // Every crop gets its own zero-padded pass, pixels of one crop never reach the receptive field of another
+        detect_impl(rgb(crop), crop_objects, prob_threshold, nms_threshold, 0, roi_scale(crop, full_scale), 0, 0.f, 0);
 
-        // clip
-        x0 = std::max(std::min(x0, (float)(width - 1)), 0.f);
-        y0 = std::max(std::min(y0, (float)(height - 1)), 0.f);
-        x1 = std::max(std::min(x1, (float)(width - 1)), 0.f);
-        y1 = std::max(std::min(y1, (float)(height - 1)), 0.f);
+        bool matched = false;
+        for (size_t j = 0; j < crop_objects.size(); j++)
+        {
+            Object obj = crop_objects[j];
+            obj.rect.x += crop.x;
+            obj.rect.y += crop.y;
 
-        objects[i].rect.x = x0;
-        objects[i].rect.y = y0;
-        objects[i].rect.width = x1 - x0;
-        objects[i].rect.height = y1 - y0;
+            const float inter = (obj.rect & roi).area();
+            const float uni = obj.rect.area() + roi.area() - inter;
+            if (uni > 0.f && inter / uni >= ROI_MATCH_IOU)
+                matched = true;
+
+            objects.push_back(obj);
+        }
+
+        if (!matched)
+            lost.push_back(i);
     }
 
-    // sort objects by area
-    struct
+    merge_objects(objects, nms_threshold);
+
+    return 0;
+}
+
+int NanoDet::detect_tracked(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    const double now = ncnn::get_current_time();
+
+    // Crops need live tracks to place them, and a full-frame pass now and then to catch new objects
+    std::vector<cv::Rect_<float> > rois;
+    bool full = !roiRedetection || !trackLastKnownPosition || !trackerRunning || roiPassesSinceFull >= ROI_FULL_FRAME_INTERVAL;
+    if (!full)
     {
-        bool operator()(const Object& a, const Object& b) const
+        const Track* tracks = tracker.tracks();
+        const float full_scale = (float)target_size / std::max(rgb.cols, rgb.rows);
+        float input_area = 0.f;
+        for (int t = 0; t < MAX_TRACKS; t++)
         {
-            return a.rect.area() > b.rect.area();
+            const Track& track = tracks[t];
+            if (!tracker.is_confirmed(track) || !track.matched)
+                continue;
+
+            const cv::Rect_<float> predicted = tracker.predicted_rect(track, now);
+            rois.push_back(predicted);
+
+            // What the crop really costs, with the upscale of small crops and the padding of every pass
+            const cv::Rect crop = roi_crop(predicted, rgb.cols, rgb.rows);
+            if (crop.width >= 2 && crop.height >= 2)
+                input_area += padded_input_area(crop.width, crop.height, roi_scale(crop, full_scale));
         }
-    } objects_area_greater;
-    std::sort(objects.begin(), objects.end(), objects_area_greater);
+
+        // A crop pass that loses a track pays for the crops and a full-frame pass on top. Crops only run while
+        // they stay well below one full-frame pass, beyond that a single full-frame pass is cheaper
+        const float full_area = padded_input_area(rgb.cols, rgb.rows, full_scale);
+        full = rois.empty() || (int)rois.size() > ROI_MAX_TRACKS || input_area > ROI_MAX_AREA_SHARE * full_area;
+    }
+
+    if (full)
+    {
+        detect(rgb, objects, prob_threshold, nms_threshold);
+        roiPassesSinceFull = 0;
+        fullPasses++;
+        fullPassMs += ncnn::get_current_time() - now;
+        return 0;
+    }
+
+    std::vector<int> lost;
+    detect_rois(rgb, rois, objects, lost, prob_threshold, nms_threshold);
+
+    if (lost.empty())
+    {
+        roiPasses++;
+        roiPassMs += ncnn::get_current_time() - now;
+        roiPassesSinceFull++;
+        return 0;
+    }
+
+    // A track whose crop found nothing may have moved further than predicted, look for it in the whole frame
+    // this time. The objects the other crops matched are kept, duplicates of them are merged away
+    std::vector<Object> full_objects;
+    detect(rgb, full_objects, prob_threshold, nms_threshold);
+    objects.insert(objects.end(), full_objects.begin(), full_objects.end());
+    merge_objects(objects, nms_threshold);
+
+    roiPassesSinceFull = 0;
+    fullPasses++;
+    fullPassMs += ncnn::get_current_time() - now;
 
     return 0;
 }
 
+std::string NanoDet::getRoiMetrics() const
+{
+    char metrics[128];
+    sprintf(metrics, "full=%d avg %.1fms, roi=%d avg %.1fms", fullPasses, fullPasses ? fullPassMs / fullPasses : 0.0,
+            roiPasses, roiPasses ? roiPassMs / roiPasses : 0.0);
+    return metrics;
+}
+
 /**
  * @brief Calculates the distance from the camera to an object using the pinhole camera model formula.
  *
@@ -474,404 +785,461 @@ float calculateDistance(float focalLengthPx, float actualObjectHeight, float obj
     return distance;
 }
 
-/**
- * @brief Analyzes navigation distances and determines optimal movement directions.
- *
- * This function evaluates a map of closest distances corresponding to various zones around the phone's camera
- * (e.g., "Near-Center", "Mid-Left") to determine the safest and most optimal navigation directions. It
- * clears any previous directions and updates the global minimal navigation directions vector (`g_MinNavDirections`)
- * based on the analysis.
- *
- * The function identifies potential paths by comparing distances in various zones to avoid obstacles
- * and maintain safe navigation. If no safe paths are found, it provides warnings or fallback directions.
- *
- * @param tempDistances A map containing zone names as keys and their respective distances as values.
- * @param g_MinNavDirections A reference to a vector that will be updated with the optimal navigation directions.
- */
+// Aggregated detections, obstacles, navigation decision and tracks of the current frame
+extern FrameResult g_frameResult;
+//Queue of track changes (new object, zone change, distance change) waiting to be read over JNI
+extern std::vector<std::string> g_trackAnnouncements;
+extern std::mutex g_trackAnnouncementsMutex;
+//Changes of the confirmed tracks, read over JNI from any sequence number
+extern EventLog g_eventLog;
+//Last sightings of every class, answers where an object was last seen without a new detection
+extern SightingMemory g_sightings;
+//Store the sentences of the find-object query of the current frame
+extern std::vector<std::string> g_findDetections;
+//Store the hits of the find-object query, FIND_HIT_STRIDE floats per hit
+extern std::vector<float> g_findHits;
+
+// Class names of the COCO dataset the model was trained on
+static const char* class_names[] = {
+        "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
+        "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
+        "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee",
+        "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard",
+        "tennis racket", "bottle", "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple",
+        "sandwich", "orange", "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch",
+        "potted plant", "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone",
+        "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear",
+        "hair drier", "toothbrush"
+};
 
-void analyzeNavigation(const std::map<std::string, float>& tempDistances, std::vector<std::string>& g_MinNavDirections) {
-    // Clear previous directions
-    g_MinNavDirections.clear();
-
-
-    bool nearCenterFound = false;
-    bool midCenterFound = false;
-    float nearCenterDistance = std::numeric_limits<float>::max();
-    float midCenterDistance = std::numeric_limits<float>::max();
-    float nearLeftDistance = std::numeric_limits<float>::max();
-    float midLeftDistance = std::numeric_limits<float>::max();
-    float nearRightDistance = std::numeric_limits<float>::max();
-    float midRightDistance = std::numeric_limits<float>::max();
-
-
-    for (const auto& entry : tempDistances) {
-        const std::string& grid_zone = entry.first;
-        float distance = entry.second;
-       // __android_log_print(ANDROID_LOG_DEBUG, "TempDistances", "Grid Zone: %s, Distance: %f", grid_zone.c_str(), distance);
-
-        if (grid_zone == "Near-Center") {
-            nearCenterFound = true;
-            nearCenterDistance = std::min(nearCenterDistance, distance);
-        } else if (grid_zone == "Mid-Center") {
-            midCenterFound = true;
-            midCenterDistance = std::min(midCenterDistance, distance);
-        } else if (grid_zone == "Near-Left") {
-            nearLeftDistance = std::min(nearLeftDistance, distance);
-        } else if (grid_zone == "Mid-Left") {
-            midLeftDistance = std::min(midLeftDistance, distance);
-        } else if (grid_zone == "Near-Right") {
-            nearRightDistance = std::min(nearRightDistance, distance);
-        } else if (grid_zone == "Mid-Right") {
-            midRightDistance = std::min(midRightDistance, distance);
-        }
-    }
+static const float object_heights[] = {
+        1.7, 1.0, 1.5, 1.1, 19.4, 3.25, 4.5, 4.0, 2.5, 4.5, 0.825, 2.25, 1.25, 0.675, 0.3, 0.25, 0.5, 1.55, 0.9, 1.5,
+        3.25, 2.8, 1.65, 5.5, 0.5, 0.9, 0.3, 1.4, 0.55, 0.025, 1.75, 1.55, 0.24, 1.0, 0.85, 0.3, 0.8, 2.25, 0.68, 0.3,
+        0.2, 0.1, 0.2, 0.23, 0.2, 0.07, 0.19, 0.1, 0.05, 0.1, 0.18, 0.2, 0.15, 0.4, 0.1, 0.18, 0.9, 1.05, 0.65, 0.6,
+        0.775, 0.45, 0.75, 0.025, 0.04, 0.2, 0.018, 0.018, 0.3, 0.9, 0.25, 0.18, 1.75, 0.035, 0.4, 0.4, 0.2, 0.5, 0.2,
+        0.175
+};
 
-    // Log the distances being compared
-    //__android_log_print(ANDROID_LOG_DEBUG, "Distances", "Near-Center Distance: %f, Mid-Center Distance: %f", nearCenterDistance, midCenterDistance);
-    //__android_log_print(ANDROID_LOG_DEBUG, "Distances", "Near-Left Distance: %f, Mid-Left Distance: %f", nearLeftDistance, midLeftDistance);
-    //__android_log_print(ANDROID_LOG_DEBUG, "Distances", "Near-Right Distance: %f, Mid-Right Distance: %f", nearRightDistance, midRightDistance);
-
-    if (!nearCenterFound && !midCenterFound) {
-        g_MinNavDirections.emplace_back("Continue ahead");
-    } else {
-        float centerDistance = nearCenterFound ? nearCenterDistance : midCenterDistance;
-        if ((nearLeftDistance > centerDistance && midLeftDistance > centerDistance) || (nearRightDistance > centerDistance && midRightDistance > centerDistance)) {
-            if (nearLeftDistance > centerDistance && midLeftDistance > centerDistance) {
-                g_MinNavDirections.emplace_back("Move left");
-            } else if (nearRightDistance > centerDistance && midRightDistance > centerDistance) {
-                g_MinNavDirections.emplace_back("Move right");
-            }
-        } else if (nearLeftDistance <= centerDistance || midLeftDistance <= centerDistance) {
-            if (nearRightDistance <= centerDistance || midRightDistance <= centerDistance) {
-                g_MinNavDirections.emplace_back("Slow down, no safe path found");
-            } else {
-                g_MinNavDirections.emplace_back("Move right");
-            }
-        } else {
-            g_MinNavDirections.emplace_back("Cannot find path, be careful");
-        }
-    }
 
-    // Log all the minimal navigation directions
-    for (const auto& direction : g_MinNavDirections) {
-        //__android_log_print(ANDROID_LOG_DEBUG, "NavDirections", "Navigation Direction: %s", direction.c_str());
-    }
-}
+static const unsigned char colors[19][3] = {
+        {54, 67, 244}, {99, 30, 233}, {176, 39, 156}, {183, 58, 103}, {181, 81, 63},
+        {243, 150, 33}, {244, 169, 3}, {212, 188, 0}, {136, 150, 0}, {80, 175, 76},
+        {74, 195, 139}, {57, 220, 205}, {59, 235, 255}, {7, 193, 255}, {0, 152, 255},
+        {34, 87, 255}, {72, 85, 121}, {158, 158, 158}, {139, 125, 96}
+};
 
+// Number of classes in the tables above
+static const int num_class_names = sizeof(class_names) / sizeof(class_names[0]);
 
-// Store all the detection results for the current frame
-extern std::vector<std::string> g_allDetections;
-//Store all the center detection results for the current frame
-extern std::vector<std::string> g_centerDetections;
-//Store all the minimal detection results for the current frame
-extern std::vector<std::string> g_MinNavDirections;
-//Store all the maximal/most comprehensive detection results for the current frame
-extern std::vector<std::string> g_MaxNavDirections;
+const char* nanodet_class_name(int label)
+{
+    if (label < 0 || label >= num_class_names)
+        return "unknown";
 
-float globalFocalLengthPx;
+    return class_names[label];
+}
 
-int NanoDet::draw(cv::Mat& rgb, const std::vector<Object>& objects)
+int nanodet_class_id(const std::string& name)
 {
-    // Initialize the focal length if not already intialized
+    for (int i = 0; i < num_class_names; i++)
     {
-        std::lock_guard<std::mutex> lock(focalLengthMutex);
-        if (!focalLengthInitialized) {
-            ACameraManager* cameraManager = ACameraManager_create();
-            if (!cameraManager) {
-                __android_log_print(ANDROID_LOG_ERROR, "NanoDet", "Failed to create ACameraManager");
-                return -1;
-            }
+        if (name == class_names[i])
+            return i;
+    }
 
-            ACameraIdList* cameraIdList = nullptr;
-            if (ACameraManager_getCameraIdList(cameraManager, &cameraIdList) != ACAMERA_OK || cameraIdList->numCameras < 1) {
-                __android_log_print(ANDROID_LOG_ERROR, "NanoDet", "No cameras found");
-                if (cameraIdList) ACameraManager_deleteCameraIdList(cameraIdList);
-                ACameraManager_delete(cameraManager);
-                return -1;
-            }
+    return -1;
+}
 
-            // Select the first desired camera ID
-            const char* cameraId = cameraIdList->cameraIds[0];
+// True if name appears in text as whole words, optionally followed by a plural "s" or "es"
+static bool contains_class_name(const std::string& text, const char* name)
+{
+    const size_t length = strlen(name);
+    for (size_t pos = text.find(name); pos != std::string::npos; pos = text.find(name, pos + 1))
+    {
+        size_t end = pos + length;
+        if (text.compare(end, 2, "es") == 0 && (end + 2 == text.size() || text[end + 2] == ' '))
+            end += 2;
+        else if (text.compare(end, 1, "s") == 0)
+            end += 1;
+
+        if ((pos == 0 || text[pos - 1] == ' ') && (end == text.size() || text[end] == ' '))
+            return true;
+    }
 
-            // Get focal length in pixels
-            focalLengthPx = NdkCamera::getFocalLengthPX(cameraManager, cameraId);
-            globalFocalLengthPx = focalLengthPx;
-            __android_log_print(ANDROID_LOG_DEBUG, "NanoDet", "Focal Length (px): %f", focalLengthPx);
+    return false;
+}
 
-            // Cleanup
-            ACameraManager_deleteCameraIdList(cameraIdList);
-            ACameraManager_delete(cameraManager);
+int nanodet_query_class_id(const std::string& query)
+{
+    // Lower case words separated by single spaces, so "My Cups!" reads "my cups"
+    std::string text;
+    for (size_t i = 0; i < query.size(); i++)
+    {
+        const unsigned char c = query[i];
+        if (isalnum(c))
+            text += (char)tolower(c);
+        else if (!text.empty() && text[text.size() - 1] != ' ')
+            text += ' ';
+    }
 
-            focalLengthInitialized = true;
+    // The longest name wins, "hot dog" is not a dog
+    int best = -1;
+    size_t best_length = 0;
+    for (int i = 0; i < num_class_names; i++)
+    {
+        const size_t length = strlen(class_names[i]);
+        if (length > best_length && contains_class_name(text, class_names[i]))
+        {
+            best = i;
+            best_length = length;
         }
     }
 
-    // Clear detections for the current frame
-    g_allDetections.clear();
-    g_centerDetections.clear();
-    g_MaxNavDirections.clear();
-
-    static const char* class_names[] = {
-            "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
-            "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
-            "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee",
-            "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard",
-            "tennis racket", "bottle", "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple",
-            "sandwich", "orange", "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch",
-            "potted plant", "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone",
-            "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear",
-            "hair drier", "toothbrush"
-    };
-
-    static const float object_heights[] = {
-            1.7, 1.0, 1.5, 1.1, 19.4, 3.25, 4.5, 4.0, 2.5, 4.5, 0.825, 2.25, 1.25, 0.675, 0.3, 0.25, 0.5, 1.55, 0.9, 1.5,
-            3.25, 2.8, 1.65, 5.5, 0.5, 0.9, 0.3, 1.4, 0.55, 0.025, 1.75, 1.55, 0.24, 1.0, 0.85, 0.3, 0.8, 2.25, 0.68, 0.3,
-            0.2, 0.1, 0.2, 0.23, 0.2, 0.07, 0.19, 0.1, 0.05, 0.1, 0.18, 0.2, 0.15, 0.4, 0.1, 0.18, 0.9, 1.05, 0.65, 0.6,
-            0.775, 0.45, 0.75, 0.025, 0.04, 0.2, 0.018, 0.018, 0.3, 0.9, 0.25, 0.18, 1.75, 0.035, 0.4, 0.4, 0.2, 0.5, 0.2,
-            0.175
-    };
+    return best;
+}
 
+// Remember where an object was seen for the last-seen queries
+static void record_sighting(const Object& obj, int zone, float distance, double timestamp_ms, int frame_w, int frame_h)
+{
+    Sighting sighting;
+    sighting.timestamp_ms = timestamp_ms;
+    sighting.zone = zone;
+    sighting.distance = distance;
+    sighting.x = obj.rect.x / frame_w;
+    sighting.y = obj.rect.y / frame_h;
+    sighting.w = obj.rect.width / frame_w;
+    sighting.h = obj.rect.height / frame_h;
+    sighting.prob = obj.prob;
+    g_sightings.record(obj.label, sighting);
+}
 
-    static const unsigned char colors[19][3] = {
-            {54, 67, 244}, {99, 30, 233}, {176, 39, 156}, {183, 58, 103}, {181, 81, 63},
-            {243, 150, 33}, {244, 169, 3}, {212, 188, 0}, {136, 150, 0}, {80, 175, 76},
-            {74, 195, 139}, {57, 220, 205}, {59, 235, 255}, {7, 193, 255}, {0, 152, 255},
-            {34, 87, 255}, {72, 85, 121}, {158, 158, 158}, {139, 125, 96}
-    };
+// Draw the bounding box and the label of one detection
+static void draw_object_box(cv::Mat& rgb, const Object& obj, int color_index)
+{
+    const unsigned char* color = colors[color_index % 19];
 
-    int color_index = 0;
+    cv::Scalar cc(color[0], color[1], color[2]);
 
-    // Define grid zones
-    int grid_rows = 3;
-    int grid_cols = 3;
-    int cell_width = rgb.cols / grid_cols;
-    int cell_height = rgb.rows / grid_rows;
+    // Draw bounding box
+    cv::rectangle(rgb, obj.rect, cc, 2);
 
-    // Lambda to get grid zone name based on object position
-    auto get_grid_zone = [&](int x_pos, int y_pos) -> std::string {
-        int row = y_pos / cell_height;
-        int col = x_pos / cell_width;
+    // Draw label
+    char text[256];
+    sprintf(text, "%s %.1f%%", nanodet_class_name(obj.label), obj.prob * 100);
 
-        if (row < 0 || row >= grid_rows || col < 0 || col >= grid_cols)
-            return "Out of bounds";
+    int baseLine = 0;
+    cv::Size label_size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
+    int x = obj.rect.x;
+    int y = obj.rect.y - label_size.height - baseLine;
+    y = (y < 0) ? 0 : y;
+    x = (x + label_size.width > rgb.cols) ? rgb.cols - label_size.width : x;
 
-        const char* row_names[] = {"Far", "Mid", "Near"};
-        const char* col_names[] = {"Left", "Center", "Right"};
+    cv::rectangle(rgb, cv::Rect(cv::Point(x, y), cv::Size(label_size.width, label_size.height + baseLine)), cc, -1);
+    cv::Scalar textcc = (color[0] + color[1] + color[2] >= 381) ? cv::Scalar(0, 0, 0) : cv::Scalar(255, 255, 255);
+    cv::putText(rgb, text, cv::Point(x, y + label_size.height), cv::FONT_HERSHEY_SIMPLEX, 0.5, textcc, 1);
+}
 
-        return std::string(row_names[row]) + "-" + col_names[col];
+// Near-row segmentation zones with less walkable surface than this are treated as blocked. The mid row usually
+// shows walls and furniture above the floor line, little floor there says nothing about the path
+static const float BLOCKED_WALKABLE_SHARE = 0.3f;
+// Near and mid zones with more road or stairs than this are blocked, the user must not be steered onto them
+static const float BLOCKED_HAZARD_SHARE = 0.2f;
+// Assumed distance of an obstacle filling a zone of the near and mid grid rows
+static const float NEAR_ROW_DISTANCE_METERS = 1.0f;
+static const float MID_ROW_DISTANCE_METERS = 2.5f;
+
+// Locate an object in the 3x3 grid (row * 3 + col), trying its bottom-center, center and top-center in turn, -1 if out of bounds
+static int grid_index_of(const Object& obj, int width, int height)
+{
+    const int cell_width = width / 3;
+    const int cell_height = height / 3;
+
+    const int x_pos = obj.rect.x + obj.rect.width / 2;
+    const int y_candidates[3] = {
+            (int)(obj.rect.y + obj.rect.height),
+            (int)(obj.rect.y + obj.rect.height / 2),
+            (int)obj.rect.y
     };
 
-    // **Aggregation Structures Start**
-    // Map to hold class-wise detections with grid zones and step counts
-    std::map<std::string, std::vector<std::pair<std::string, int>>> aggregatedDetections;
-    // **Aggregation Structures End**
-
-    // Temporary structure to store distances
-    std::map<std::string, float> tempDistances;
+    for (int i = 0; i < 3; i++)
+    {
+        int row = y_candidates[i] / cell_height;
+        int col = x_pos / cell_width;
 
-    // Log the contents of tempDistances
-    for (const auto& entry : tempDistances) {
-        const std::string& grid_zone = entry.first;
-        float distance = entry.second;
-        //__android_log_print(ANDROID_LOG_DEBUG, "flowexecutiondraw", "1. Grid Zone: %s, Distance: %f", grid_zone.c_str(), distance);
+        if (row >= 0 && row < 3 && col >= 0 && col < 3)
+            return row * 3 + col;
     }
 
+    return -1;
+}
 
-    // Process each detected object
-    for (const auto& obj : objects) {
-        const unsigned char* color = colors[color_index % 19];
-        color_index++;
+// Boxes ending this close to the bottom edge may be cut off, their floor contact is not visible
+static const float GROUND_CONTACT_MARGIN = 4.0f;
 
-        cv::Scalar cc(color[0], color[1], color[2]);
+// Distance to an object from the floor row under its box, falling back to its class height when the
+// contact point is not visible. -1 if neither works
+static float object_distance(const Object& obj, const CameraIntrinsics& intrinsics, const GroundPlane& ground, int frame_rows)
+{
+    const float bottom = obj.rect.y + obj.rect.height;
+    if (bottom < frame_rows - GROUND_CONTACT_MARGIN) {
+        const float distance = ground.distance_at_row(bottom);
+        if (distance > 0.0f)
+            return distance;
+    }
 
-        // Draw bounding box
-        cv::rectangle(rgb, obj.rect, cc, 2);
+    if (obj.label < 0 || obj.label >= (int)(sizeof(object_heights) / sizeof(object_heights[0])))
+        return -1.0f;
 
-        // Draw label
-        char text[256];
-        sprintf(text, "%s %.1f%%", class_names[obj.label], obj.prob * 100);
+    return calculateDistance(intrinsics.fy, object_heights[obj.label], obj.rect.height);
+}
 
-        int baseLine = 0;
-        cv::Size label_size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
-        int x = obj.rect.x;
-        int y = obj.rect.y - label_size.height - baseLine;
-        y = (y < 0) ? 0 : y;
-        x = (x + label_size.width > rgb.cols) ? rgb.cols - label_size.width : x;
+void NanoDet::clear_last_known_zones()
+{
+    for (int i = 0; i < FRAME_MAX_CLASSES; i++)
+    {
+        lastKnownZones[i] = ZONE_OUT_OF_BOUNDS;
+    }
+}
 
-        cv::rectangle(rgb, cv::Rect(cv::Point(x, y), cv::Size(label_size.width, label_size.height + baseLine)), cc, -1);
-        cv::Scalar textcc = (color[0] + color[1] + color[2] >= 381) ? cv::Scalar(0, 0, 0) : cv::Scalar(255, 255, 255);
-        cv::putText(rgb, text, cv::Point(x, y + label_size.height), cv::FONT_HERSHEY_SIMPLEX, 0.5, textcc, 1);
+void NanoDet::adopt_tracking_state(NanoDet& other)
+{
+    tracker = other.tracker;
+    trackerRunning = other.trackerRunning;
+    memcpy(lastKnownZones, other.lastKnownZones, sizeof(lastKnownZones));
+    trackLastKnownPosition = other.trackLastKnownPosition;
+    cameraIntrinsics = other.cameraIntrinsics;
+    occupancyGrid = other.occupancyGrid;
+    polarHistogram = other.polarHistogram;
+}
 
-        // Determine primary bottom-center position
-        int x_pos = obj.rect.x + obj.rect.width / 2;
-        int y_pos = obj.rect.y + obj.rect.height;
-        std::string grid_zone = get_grid_zone(x_pos, y_pos);
+int NanoDet::draw(cv::Mat& rgb, const std::vector<Object>& objects, bool fresh)
+{
+    // Distances need the focal length of the opened camera
+    if (!cameraIntrinsics.valid)
+        return -1;
+    groundPlane.update(cameraIntrinsics, cameraPitch, cameraPitchValid);
+
+    // Aggregate into the fixed tables of the frame result, the sentences are generated when a JNI getter asks
+    FrameResult& result = g_frameResult;
+    result.begin_frame(ncnn::get_current_time());
+
+    frameDistances.assign(objects.size(), -1.0f);
+    frameZones.assign(objects.size(), -1);
+    frameDetections.assign(objects.size(), -1);
+
+    // Republished objects were already fused, adding them again would count one detection as several hits.
+    // The grid and the histogram keep their last direction and heading until the next inference
+    if (fresh) {
+        // The direction follows the obstacles fused over the recent frames, not just this one
+        occupancyGrid.begin_frame(rgb.cols, rgb.rows, result.timestamp_ms);
+
+        // The heading follows the directions of the obstacles of this frame
+        polarHistogram.configure(cameraIntrinsics);
+        polarHistogram.begin_frame();
+    }
 
-        // Center fallback if out of bounds
-        if (grid_zone == "Out of bounds") {
-            x_pos = obj.rect.x + obj.rect.width / 2;
-            y_pos = obj.rect.y + obj.rect.height / 2;
-            grid_zone = get_grid_zone(x_pos, y_pos);
-        }
+    // Process each detected object
+    for (size_t object_index = 0; object_index < objects.size(); object_index++) {
+        const Object& obj = objects[object_index];
 
-        // Top fallback if center is out of bounds
-        if (grid_zone == "Out of bounds") {
-            x_pos = obj.rect.x + obj.rect.width / 2;
-            y_pos = obj.rect.y;
-            grid_zone = get_grid_zone(x_pos, y_pos);
-        }
+        // Draw bounding box and label
+        draw_object_box(rgb, obj, object_index);
 
-        // Output object height in pixels
-        float object_height_px = obj.rect.height;
-        //__android_log_print(ANDROID_LOG_DEBUG, "NanoDet", "Object height (px): %f", object_height_px);
+        // Locate the object in the grid from its bottom-center, falling back to its center and top
+        const int grid_index = grid_index_of(obj, rgb.cols, rgb.rows);
+        frameZones[object_index] = grid_index;
 
-        //__android_log_print(ANDROID_LOG_DEBUG, "NanoDet", "Object Label (0-79): %d", obj.label);
+        // Only labels of the class tables are aggregated
+        if (obj.label < 0 || obj.label >= FRAME_MAX_CLASSES || obj.label >= (int)(sizeof(object_heights) / sizeof(object_heights[0])))
+            continue;
 
-        // Ensure we have a valid label index for object_heights
-        if (obj.label >= 0 && obj.label < sizeof(object_heights) / sizeof(object_heights[0])) {
-            float actual_height = object_heights[obj.label]; // Get the actual height of the object in meters
-            // __android_log_print(ANDROID_LOG_DEBUG, "NanoDet", "Actual Height (meters): %f", actual_height);
+        const float distance = object_distance(obj, cameraIntrinsics, groundPlane, rgb.rows);
+        frameDistances[object_index] = distance;
 
-            // Calculate the distance from the camera for this object
-            float distance = calculateDistance(focalLengthPx, actual_height, object_height_px);
+        // The closest object of a zone is its obstacle
+        result.add_obstacle(grid_index, distance);
+        if (fresh) {
+            occupancyGrid.observe_box(obj.rect.x, obj.rect.x + obj.rect.width, obj.rect.y + obj.rect.height, distance);
+            polarHistogram.add_obstacle(obj.rect.x, obj.rect.x + obj.rect.width, distance);
+        }
+        record_sighting(obj, grid_index, distance, result.timestamp_ms, rgb.cols, rgb.rows);
+
+        // Convert the distance to steps (assuming average step length is 0.75 meters)
+        const float step_length = 0.75f;
+        const int steps = distance / step_length;
+
+        if (result.num_detections < FRAME_MAX_DETECTIONS) {
+            frameDetections[object_index] = result.num_detections;
+            FrameDetection& det = result.detections[result.num_detections++];
+            det.label = obj.label;
+            det.zone = grid_index;
+            det.steps = steps;
+            det.prob = obj.prob;
+            det.x = obj.rect.x;
+            det.y = obj.rect.y;
+            det.w = obj.rect.width;
+            det.h = obj.rect.height;
+            det.distance = distance;
+            det.track_id = 0;
+            result.class_counts[obj.label]++;
+        }
+    }
 
-            // Log the actual distance
-            //__android_log_print(ANDROID_LOG_DEBUG, "flowexecutiondraw", "Actual Distance: %f", distance);
+    // Zones with road or stairs, and near zones with little walkable surface, are obstacles at the distance of their grid row
+    if (surfaceZones && surfaceZones->valid) {
+        for (int zone = ZONE_MID_LEFT; zone < ZONE_COUNT; zone++) {
+            const bool near_row = zone >= ZONE_NEAR_LEFT;
+            const bool hazard = surfaceZones->hazard[zone] >= BLOCKED_HAZARD_SHARE;
+            if (!hazard && !(near_row && surfaceZones->walkable[zone] < BLOCKED_WALKABLE_SHARE))
+                continue;
 
-            // Initialize the grid zone distance with a max distance to get the closest object in a grid zone
-            if (tempDistances.find(grid_zone) == tempDistances.end()) {
-                tempDistances[grid_zone] = std::numeric_limits<float>::max();
-            }
+            const float blocked_distance = near_row ? NEAR_ROW_DISTANCE_METERS : MID_ROW_DISTANCE_METERS;
+            result.add_obstacle(zone, blocked_distance);
+            if (!fresh)
+                continue;
 
-            // Store the distance in the temporary structure
-            tempDistances[grid_zone] = std::min(tempDistances[grid_zone], distance);
-
-            // Log the contents of tempDistances
-            //__android_log_print(ANDROID_LOG_DEBUG, "flowexecutiondraw", "2. Grid Zone: %s, Distance: %f", grid_zone.c_str(), tempDistances[grid_zone]);
-
-            // Convert the distance to steps (assuming average step length is 0.75 meters)
-            float step_length = 0.75; // Average step length in meters
-            int steps = distance / step_length;
-
-            // Log the calculated distance and steps
-            if (distance > 0.0f) {
-                char distance_log[256];
-                if (steps < 1) {
-                    sprintf(distance_log, "Distance to %s: %.2f meters, Steps: %d. Stretch out your hand!", class_names[obj.label], distance, steps);
-                } else {
-                    sprintf(distance_log, "Distance to %s: %.2f meters, Steps: %d", class_names[obj.label], distance, steps);
-                }
-                //__android_log_print(ANDROID_LOG_DEBUG, "NanoDet", "%s", distance_log);
-            } else {
-                //__android_log_print(ANDROID_LOG_ERROR, "NanoDet", "Invalid distance calculation for %s", class_names[obj.label]);
-            }
+            occupancyGrid.observe_zone(zone, blocked_distance);
 
-            // **Aggregation Logic Start**
-            // Aggregate detections by class
-            std::string detected_class = std::string(class_names[obj.label]);
-            aggregatedDetections[detected_class].emplace_back(grid_zone, steps);
-            // **Aggregation Logic End**
-        } else {
-            //__android_log_print(ANDROID_LOG_ERROR, "NanoDet", "Invalid label index for %s", class_names[obj.label]);
+            const int zone_col = zone % 3;
+            polarHistogram.add_obstacle(zone_col * rgb.cols / 3.f, (zone_col + 1) * rgb.cols / 3.f, blocked_distance);
         }
+    }
 
-        //std::string detection_str = "Detected " + std::string(class_names[obj.label]) + " at " + grid_zone ;
-        //std::string objectID = std::string(class_names[obj.label]);
-
+    if (fresh) {
+        occupancyGrid.end_frame();
+        polarHistogram.end_frame();
     }
+    result.direction = occupancyGrid.direction();
 
-    // **After Processing All Objects: Aggregated Logging Start**
-    for (const auto& entry : aggregatedDetections) {
-        const std::string& detected_class = entry.first;
-        const std::vector<std::pair<std::string, int>>& detections = entry.second;
-        int count = detections.size();
+    result.heading = polarHistogram.heading();
+    result.heading_width = polarHistogram.valley_width();
+    result.heading_ahead = polarHistogram.ahead();
 
-        // Collect grid zones and step counts
-        std::vector<std::string> grid_zones;
-        std::vector<std::string> step_messages;
-        std::vector<std::string> nav_step_messages;
-        for (const auto& det : detections) {
-            grid_zones.push_back(det.first);
-            if (det.second < 1) {
-                step_messages.push_back("Stretch out your hand!");
-                nav_step_messages.emplace_back("Less than a step away");
-            } else {
-                step_messages.push_back("Take " + std::to_string(det.second) + " steps.");
-                nav_step_messages.emplace_back("In " + std::to_string(det.second) + " steps.");
+    // Surfaces under and just ahead of the user become caution messages
+    if (surfaceZones) {
+        result.has_surface = true;
+        result.surface = *surfaceZones;
+    }
 
-            }
+    // Follow objects across frames so that only changes need to be announced
+    if (trackLastKnownPosition) {
+        // Republished objects are the ones of the last update, matching them again would confirm tracks on a single detection
+        if (fresh || !trackerRunning) {
+            trackerRunning = true;
+            tracker.update(objects, frameDistances.data(), frameZones.data(), result.timestamp_ms);
         }
 
-        // Concatenate grid zones
-        std::string grid_zone_str;
-        for (size_t i = 0; i < grid_zones.size(); ++i) {
-            grid_zone_str += grid_zones[i];
-            if (i != grid_zones.size() - 1) {
-                grid_zone_str += ", ";
+        std::vector<std::string> announcements;
+        g_eventLog.begin_frame();
+        Track* tracks = tracker.tracks();
+        for (int t = 0; t < MAX_TRACKS; t++) {
+            Track& track = tracks[t];
+            if (!tracker.is_confirmed(track) || track.zone < 0)
+                continue;
+
+            // Confirmed tracks stay in the event stream while they coast through missed detections
+            g_eventLog.observe(track.id, track.label, track.zone, track.smoothed_distance);
+
+            // Remember where each class was seen last, even after it leaves the frame
+            if (track.label >= 0 && track.label < FRAME_MAX_CLASSES)
+                lastKnownZones[track.label] = track.zone;
+
+            if (!track.matched)
+                continue;
+
+            // Objects of the frame carry the ID of their confirmed track
+            const std::vector<int>& track_ids = tracker.detection_track_ids();
+            for (size_t i = 0; i < track_ids.size(); i++) {
+                if (track_ids[i] == track.id && frameDetections[i] >= 0)
+                    result.detections[frameDetections[i]].track_id = track.id;
             }
-        }
 
-        // Concatenate step messages
-        std::string step_str;
-        for (size_t i = 0; i < step_messages.size(); ++i) {
-            step_str += step_messages[i];
-            if (i != step_messages.size() - 1) {
-                step_str += ", ";
+            FrameTrack& tracked = result.tracks[result.num_tracks++];
+            tracked.id = track.id;
+            tracked.label = track.label;
+            tracked.zone = track.zone;
+            tracked.distance = track.smoothed_distance;
+
+            // Announcements are rare events, their text is built right away
+            if (tracker.take_announcement(track)) {
+                int steps = track.smoothed_distance / 0.75f;
+                std::string step_msg = (steps < 1) ? "Stretch out your hand!" :
+                                       "Take " + std::to_string(steps) + " steps.";
+                announcements.push_back(std::string("Detected ") + nanodet_class_name(track.label) + " at " + grid_zone_name(track.zone) + ". " + step_msg);
             }
         }
 
-        // Concatenate nav step messages
-        std::string nav_step_str;
-        for (size_t i = 0; i < nav_step_messages.size(); ++i) {
-            nav_step_str += nav_step_messages[i];
-            if (i != nav_step_messages.size() - 1) {
-                nav_step_str += ", ";
-            }
-        }
+        g_eventLog.end_frame();
 
-        // Create aggregated detection string
-        std::string aggregated_str = std::to_string(count) + " " + detected_class + " detected at " + grid_zone_str + ". " + step_str;
+        if (!announcements.empty()) {
+            std::lock_guard<std::mutex> guard(g_trackAnnouncementsMutex);
+            g_trackAnnouncements.insert(g_trackAnnouncements.end(), announcements.begin(), announcements.end());
 
-        std::string aggregated_nav_str = std::to_string(count) + " " + detected_class + " detected at " + grid_zone_str + ". "+ nav_step_str ;
+            // Keep only the newest announcements if nobody is reading them
+            const size_t max_pending = 32;
+            if (g_trackAnnouncements.size() > max_pending)
+                g_trackAnnouncements.erase(g_trackAnnouncements.begin(), g_trackAnnouncements.end() - max_pending);
+        }
+    } else if (trackerRunning) {
+        // Tracking was switched off, forget the tracks so stale IDs are not resumed later
+        tracker.reset();
+        clear_last_known_zones();
+        g_eventLog.clear_objects();
+        trackerRunning = false;
+    }
+
+    return 0;
+}
 
-        // Log the aggregated detection
-       // __android_log_print(ANDROID_LOG_DEBUG, "NanoDet", "%s", aggregated_str.c_str());
+int NanoDet::draw_find(cv::Mat& rgb, const std::vector<Object>& objects)
+{
+    // Distances need the focal length of the opened camera
+    if (!cameraIntrinsics.valid)
+        return -1;
+    groundPlane.update(cameraIntrinsics, cameraPitch, cameraPitchValid);
 
-        // Log the aggregated nav detection
-        //__android_log_print(ANDROID_LOG_DEBUG, "NanoDetNavigation", "%s", aggregated_nav_str.c_str());
+    g_findDetections.clear();
+    g_findHits.clear();
 
-        // Add to g_allDetections
-        g_allDetections.push_back(aggregated_str);
+    // Group the zones and step counts of the hits by class, the objects only hold the queried classes
+    std::map<int, std::pair<std::string, std::string>> zones_and_steps;
+    std::map<int, int> counts;
 
-        // Add to g_MaxNavDirections
-        g_MaxNavDirections.push_back(aggregated_nav_str);
+    int color_index = 0;
+    for (size_t i = 0; i < objects.size(); i++) {
+        const Object& obj = objects[i];
 
-        // Add to g_centerDetections based on specific grid zones
-        for (const auto& det : detections) {
-            if (det.first == "Mid-Center" || det.first == "Far-Center" || det.first == "Near-Center") {
-                // Find the corresponding step message
-                std::string step_msg = (det.second < 1) ? "Stretch out your hand!" :
-                                       "Take " + std::to_string(det.second) + " steps.";
-                std::string center_detection_str = "Detected " + detected_class + " at " + det.first + ". " + step_msg;
-                g_centerDetections.push_back(center_detection_str);
+        draw_object_box(rgb, obj, color_index);
+        color_index++;
 
-                // Log the center detection
-                //__android_log_print(ANDROID_LOG_DEBUG, "NCenterDetection", "Center Detection: %s", center_detection_str.c_str());
-            }
+        const int grid_index = grid_index_of(obj, rgb.cols, rgb.rows);
+        const float distance = object_distance(obj, cameraIntrinsics, groundPlane, rgb.rows);
+        const int steps = distance / 0.75f;
+        record_sighting(obj, grid_index, distance, ncnn::get_current_time(), rgb.cols, rgb.rows);
+
+        // Structured hit: label, probability, box, zone index and distance
+        const float hit[FIND_HIT_STRIDE] = {
+                (float)obj.label, obj.prob,
+                obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height,
+                (float)grid_index, distance
+        };
+        g_findHits.insert(g_findHits.end(), hit, hit + FIND_HIT_STRIDE);
+
+        std::pair<std::string, std::string>& entry = zones_and_steps[obj.label];
+        if (counts[obj.label]++ > 0) {
+            entry.first += ", ";
+            entry.second += ", ";
         }
+        entry.first += grid_zone_name(grid_index);
+        entry.second += (steps < 1) ? "Stretch out your hand!" : "Take " + std::to_string(steps) + " steps.";
     }
-    // **After Processing All Objects: Aggregated Logging End**
 
-    // Log the contents of tempDistances before calling analyzeNavigation
-    for (const auto& entry : tempDistances) {
-        const std::string& grid_zone = entry.first;
-        float distance = entry.second;
-        //__android_log_print(ANDROID_LOG_DEBUG, "flowexecutiondraw", "3. Grid Zone: %s, Distance: %f", grid_zone.c_str(), distance);
+    // Same sentence as the general detection, built only for the queried classes
+    for (const auto& entry : zones_and_steps) {
+        g_findDetections.push_back(std::to_string(counts[entry.first]) + " " + nanodet_class_name(entry.first)
+                                   + " detected at " + entry.second.first + ". " + entry.second.second);
     }
 
-    // Call the analyzeNavigation function with the temporary structure
-    analyzeNavigation(tempDistances, g_MinNavDirections);
-
     return 0;
 }
 
@@ -22,11 +22,24 @@
 
 #include <string>
 #include <vector>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <pthread.h>
 
 #include <platform.h>
 #include <benchmark.h>
 
 #include "../header/nanodet.h"
+#include "../header/motiongate.h"
+#include "../header/cpupolicy.h"
+#include "../header/segmenter.h"
+#include "../header/asyncdetector.h"
+#include "../header/announcer.h"
 
 #include "../header/ndkcamera.h"
 
@@ -125,28 +138,345 @@ static int draw_fps(cv::Mat& rgb)
 }
 
 
-static NanoDet* g_nanodet = 0;
+// Detection model of the pipeline, an entry of the manifest table in decoder.cpp
+static const char* MODEL_TYPE = "ELite1_416";
+
+// Model used by the render loop. Loads build a second instance off the lock and swap it in between frames.
+// The replaced instance is released as soon as the executor, which may still be in a forward pass on it, lets go
+static std::shared_ptr<NanoDet> g_nanodet;
 static ncnn::Mutex lock;
 
+// Tracking switch requested over JNI, applied to whichever model is loaded
+static bool g_trackingEnabled = false;
+// Output plan of the general detection, set by the navigation screen
+static int g_detectMode = DETECT_MODE_FULL;
+// Re-detect only around tracked objects between full-frame passes, needs tracking
+static bool g_roiRedetectionEnabled = false;
+// Occupancy grid configuration requested over JNI, applied by the next render since it clears the grid
+static int g_occupancyCols = 6;
+static int g_occupancyRows = 6;
+static float g_occupancyHalfLifeMs = 600.f;
+static bool g_occupancyConfigChanged = false;
+
+// Skips inference on static scenes, decided from the Y plane before each render
+static MotionGate g_motionGate;
+static bool g_runInference = true;
+// Detections of the last frame that ran inference, republished while the gate skips
+static std::vector<Object> g_lastObjects;
+// Hits of the find query in the last frame that ran inference, kept beside the general detections
+static std::vector<Object> g_lastFindObjects;
+
+// Class searched by the find-object screen, -1 runs the general detection
+static int g_findClassId = -1;
+// Time of the last find query, find mode ends when the screen stops asking
+static double g_findLastQueryMs = 0.0;
+static const double FIND_TIMEOUT_MS = 30000.0;
+
+// Big cluster placement and thread count governor of the forward pass
+static CpuPolicy g_cpuPolicy;
+
+// On-device surface segmentation, loaded when first enabled and run at a lower rate than detection
+static std::shared_ptr<Segmenter> g_segmenter;
+// Labels frames on its own thread, the render loop hands it a frame per interval and picks up the newest zones
+static SegmentationWorker g_segmentationWorker;
+// Set once the segmentation assets were found missing, later requests fail without looking again
+static bool g_segmenterMissing = false;
+static bool g_segmentationEnabled = false;
+static SurfaceZones g_surfaceZones;
+static double g_lastSegmentationMs = 0.0;
+static const double SEGMENTATION_INTERVAL_MS = 300.0;
+
+// Residency of g_nanodet: the configuration it was loaded with and the screens using it.
+// The model stays loaded when the last user leaves and is only freed by trimModel
+static int g_residentCpuGpu = -1;
+static int g_modelRefs = 0;
+
+// Configuration of the newest loadModel request and the loads still running for it
+static int g_requestedCpuGpu = -1;
+static int g_loadGeneration = 0;
+static int g_pendingLoads = 0;
+// Global reference keeping the Java AssetManager alive for background loads
+static jobject g_assetManagerRef = 0;
+// Background loads run one after the other on the loader thread, loadModel queues them and returns at once.
+// A queued load that a newer request superseded returns without building anything
+static std::mutex g_loaderMutex;
+static std::condition_variable g_loaderWake;
+static std::thread g_loaderThread;
+static std::deque<std::function<bool()> > g_loaderQueue;
+static bool g_loaderStopping = false;
+
+static void run_loader()
+{
+    for (;;)
+    {
+        std::function<bool()> load;
+        {
+            std::unique_lock<std::mutex> g(g_loaderMutex);
+            g_loaderWake.wait(g, [] { return g_loaderStopping || !g_loaderQueue.empty(); });
+            if (g_loaderStopping)
+                break;
+
+            load.swap(g_loaderQueue.front());
+            g_loaderQueue.pop_front();
+        }
+
+        load();
+    }
+}
+
+// Result of the frame being drawn, filled by NanoDet::draw and only touched by the render thread
+FrameResult g_frameResult;
+// Finished frames published for the JNI getters, which read them without taking the render lock
+// and generate their sentences from their copy
+static FrameResultSnapshots g_frameSnapshots;
+
+// Detection off the render thread: frames go to the executor and the boxes of the newest finished frame are
+// drawn meanwhile. A frame that is still waiting when the next one arrives is cancelled
+static AsyncDetector g_asyncDetector;
+static bool g_asyncEnabled = false;
+// Set by the executor when a result is waiting for the next draw
+static bool g_asyncResultReady = false;
+
+// Listener receiving the detection sentences as soon as a frame with fresh detections is drawn
+static JavaVM* g_vm = 0;
+static pthread_key_t g_jniDetachKey;
+static ncnn::Mutex g_listenerLock;
+static jobject g_detectionListener = 0;
+static jmethodID g_onDetections = 0;
+// Set while a detection listener is registered, checked by the render loop without the listener lock
+static std::atomic<bool> g_detectionListening(false);
+
+// Listener receiving the spoken guidance chosen by the scheduler, guarded by g_listenerLock like the detection listener
+static AnnouncementScheduler g_announcer;
+static jobject g_announcementListener = 0;
+static jmethodID g_onAnnouncement = 0;
+// Set while an announcement listener is registered, checked by the render loop without the listener lock
+static std::atomic<bool> g_announcing(false);
+
+// Env of the calling thread, attaching native threads on first use. Attached threads detach when they exit
+static JNIEnv* attached_env()
+{
+    JNIEnv* env = 0;
+    if (!g_vm)
+        return 0;
+    if (g_vm->GetEnv((void**)&env, JNI_VERSION_1_4) == JNI_OK)
+        return env;
+    if (g_vm->AttachCurrentThread(&env, 0) != JNI_OK)
+        return 0;
+
+    pthread_setspecific(g_jniDetachKey, env);
+    return env;
+}
+
+static void detach_thread(void* env)
+{
+    if (g_vm)
+        g_vm->DetachCurrentThread();
+}
+
+// Local reference to a registered listener, taken under g_listenerLock so the call can run without it: a listener
+// may register or clear listeners from its callback, and a slow one must not hold up the setters
+static jobject listener_ref(JNIEnv* env, jobject listener)
+{
+    return listener ? env->NewLocalRef(listener) : 0;
+}
+
+// Hand the detection sentences of a frame to the Java listener, called without the render lock
+static void push_detections(const std::vector<std::string>& detections)
+{
+    JNIEnv* env = attached_env();
+    if (!env)
+        return;
+
+    jobject listener;
+    jmethodID on_detections;
+    {
+        ncnn::MutexLockGuard g(g_listenerLock);
+        listener = listener_ref(env, g_detectionListener);
+        on_detections = g_onDetections;
+    }
+    if (!listener)
+        return;
+
+    jobjectArray array = env->NewObjectArray(detections.size(), env->FindClass("java/lang/String"), 0);
+    for (size_t i = 0; i < detections.size(); i++) {
+        jstring detection = env->NewStringUTF(detections[i].c_str());
+        env->SetObjectArrayElement(array, i, detection);
+        env->DeleteLocalRef(detection);
+    }
+
+    env->CallVoidMethod(listener, on_detections, array);
+    if (env->ExceptionCheck()) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+    env->DeleteLocalRef(array);
+    env->DeleteLocalRef(listener);
+}
+
+// Let the scheduler look at a drawn frame and hand a due announcement to the Java listener, called without the render lock
+static void push_announcement(const FrameResult& result)
+{
+    JNIEnv* env = attached_env();
+    if (!env)
+        return;
+
+    // The scheduler is guarded by the listener lock, the Java call runs after it was released
+    std::string text;
+    bool urgent = false;
+    jobject listener;
+    jmethodID on_announcement;
+    {
+        ncnn::MutexLockGuard g(g_listenerLock);
+        if (!g_announcementListener || !g_announcer.next(result, ncnn::get_current_time(), text, urgent))
+            return;
+
+        listener = listener_ref(env, g_announcementListener);
+        on_announcement = g_onAnnouncement;
+    }
+
+    jstring announcement = env->NewStringUTF(text.c_str());
+    env->CallVoidMethod(listener, on_announcement, announcement, urgent ? JNI_TRUE : JNI_FALSE);
+    if (env->ExceptionCheck()) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+    env->DeleteLocalRef(announcement);
+    env->DeleteLocalRef(listener);
+}
+
+// Completion of an asynchronous detection, runs on the executor thread
+static void on_async_detections(int request_id, int status, const std::vector<Object>& objects, const std::vector<Object>& find_objects, double inference_ms)
+{
+    // Cancelled frames are reported from inside submit(), which runs under the render lock
+    if (status != ASYNC_DETECT_DONE)
+        return;
+
+    ncnn::MutexLockGuard g(lock);
+
+    // A switch back to synchronous detection fills g_lastObjects on the render thread
+    if (!g_asyncEnabled)
+        return;
+
+    g_lastObjects = objects;
+
+    // The frame may have been submitted for another query, or before find mode started
+    if (g_findClassId >= 0)
+    {
+        g_lastFindObjects.clear();
+        for (size_t i = 0; i < find_objects.size(); i++)
+        {
+            if (find_objects[i].label == g_findClassId)
+                g_lastFindObjects.push_back(find_objects[i]);
+        }
+    }
+    g_asyncResultReady = true;
+    g_motionGate.record_inference_time(inference_ms);
+    // The executor runs with the thread count the policy picks, so its passes are what the policy learns from
+    g_cpuPolicy.record_inference_time(inference_ms, ncnn::get_current_time());
+}
+
 class MyNdkCamera : public NdkCameraWindow
 {
 public:
+    virtual void on_image_luma(const unsigned char* y, int width, int height) const;
     virtual void on_image_render(cv::Mat& rgb) const;
 };
 
+//Decide whether the coming frame needs a new detection
+void MyNdkCamera::on_image_luma(const unsigned char* y, int width, int height) const
+{
+    ncnn::MutexLockGuard g(lock);
+    g_runInference = g_motionGate.update(y, width, height, width, ncnn::get_current_time());
+}
+
 //Manage camera frame rendering
 void MyNdkCamera::on_image_render(cv::Mat& rgb) const
 {
+    // Set when the frame drawn has detections of a new inference, not ones republished from an earlier frame.
+    // Its result is pushed to the listener once the lock is released
+    bool fresh = false;
+
     // nanodet
     {
         ncnn::MutexLockGuard g(lock);
         //Check is a nanodet object is available
         if (g_nanodet)
         {
-            std::vector<Object> objects;
-            g_nanodet->detect(rgb, objects);
+            g_nanodet->trackLastKnownPosition = g_trackingEnabled;
+            g_nanodet->set_camera_intrinsics(frame_intrinsics());
+            g_nanodet->set_camera_pitch(camera_pitch, camera_pitch_valid);
+            if (g_occupancyConfigChanged)
+            {
+                g_nanodet->configure_occupancy_grid(g_occupancyCols, g_occupancyRows, g_occupancyHalfLifeMs);
+                g_occupancyConfigChanged = false;
+            }
+            g_nanodet->set_roi_redetection(g_roiRedetectionEnabled);
+
+            if (g_findClassId >= 0 && ncnn::get_current_time() - g_findLastQueryMs > FIND_TIMEOUT_MS)
+            {
+                // Nobody polls the find results any more, go back to the general detection
+                g_findClassId = -1;
+                g_motionGate.reset();
+                g_runInference = true;
+            }
+
+            if (g_runInference)
+            {
+                g_cpuPolicy.bind_inference_thread();
+                g_nanodet->set_num_threads(g_cpuPolicy.inference_threads());
+            }
 
-            g_nanodet->draw(rgb, objects);
+            // Hand the frame to the segmentation worker before boxes are drawn onto it, the zones of the newest
+            // labelled frame are used meanwhile
+            if (g_segmentationEnabled && g_segmenter)
+            {
+                if (ncnn::get_current_time() - g_lastSegmentationMs >= SEGMENTATION_INTERVAL_MS && g_segmentationWorker.submit(rgb))
+                    g_lastSegmentationMs = ncnn::get_current_time();
+                g_segmentationWorker.latest(g_surfaceZones);
+            }
+            g_nanodet->set_surface_zones(g_segmentationEnabled && g_segmenter ? &g_surfaceZones : 0);
+
+            // The general detection keeps running during a find query, the navigation guidance must not go
+            // stale while the find screen polls. The query is decoded from the outputs of the same forward pass
+            const bool finding = g_findClassId >= 0;
+            std::vector<int> find_class_ids;
+            if (finding)
+                find_class_ids.push_back(g_findClassId);
+
+            if (g_runInference && g_asyncEnabled)
+            {
+                // The executor works on a copy since the camera reuses this buffer
+                g_asyncDetector.set_num_threads(g_cpuPolicy.inference_threads());
+                g_asyncDetector.submit(rgb.clone(), on_async_detections, detect_mode_heads(g_detectMode), find_class_ids);
+            }
+            else if (g_runInference)
+            {
+                double start = ncnn::get_current_time();
+
+                // Crops around the tracks would not show the queried object, find mode runs full-frame passes
+                if (finding)
+                    g_nanodet->detect_find(rgb, find_class_ids, g_lastObjects, g_lastFindObjects);
+                else
+                    g_nanodet->detect_tracked(rgb, g_lastObjects);
+
+                double end = ncnn::get_current_time();
+                g_motionGate.record_inference_time(end - start);
+                g_cpuPolicy.record_inference_time(end - start, end);
+                fresh = true;
+            }
+
+            if (g_asyncResultReady)
+            {
+                g_asyncResultReady = false;
+                fresh = true;
+            }
+
+            g_nanodet->draw(rgb, g_lastObjects, fresh);
+            if (finding)
+                g_nanodet->draw_find(rgb, g_lastFindObjects);
+
+            g_frameSnapshots.publish(g_frameResult);
         }
         else
         {
@@ -155,17 +485,45 @@ void MyNdkCamera::on_image_render(cv::Mat& rgb) const
     }
 
 
+    // Nothing is read or formatted for listeners nobody registered
+    const bool pushing = fresh && g_detectionListening;
+    if (pushing || g_announcing)
+    {
+        // Only this thread publishes, the snapshot is the frame just drawn
+        FrameResult pushed;
+        g_frameSnapshots.read(pushed);
+
+        if (pushing)
+        {
+            std::vector<std::string> detections;
+            frame_detection_sentences(pushed, detections);
+            push_detections(detections);
+        }
+
+        if (g_announcing)
+            push_announcement(pushed);
+    }
+
     draw_fps(rgb);
 }
 
 static MyNdkCamera* g_camera = 0;
 
+// Focal length of the full camera stream, as sent with getLatestFrame frames, 0 until a camera was opened
+static std::atomic<float> g_streamFocalLengthPx(0.f);
+
 extern "C" {
     //initialize resources when the library loads
 JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved)
 {
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "JNI_OnLoad");
 
+    g_vm = vm;
+    pthread_key_create(&g_jniDetachKey, detach_thread);
+
+    // The executor runs forward passes like the render thread, keep it on the big cluster
+    g_asyncDetector.set_thread_hooks([]() { g_cpuPolicy.bind_inference_thread(); }, std::function<void()>());
+
     g_camera = new MyNdkCamera;
 
     return JNI_VERSION_1_4;
@@ -176,12 +534,27 @@ JNIEXPORT void JNI_OnUnload(JavaVM* vm, void* reserved)
 {
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "JNI_OnUnload");
 
+    // The executor may be in a forward pass on g_nanodet, finish it and join the thread before anything is
+    // released. Its completion takes the render lock, so this runs without it
+    g_asyncDetector.stop();
+    g_segmentationWorker.stop();
+
+    // A background load must not swap a model in while the models are released, queued loads are dropped
     {
-        ncnn::MutexLockGuard g(lock);
+        std::lock_guard<std::mutex> g(g_loaderMutex);
+        g_loaderStopping = true;
+    }
+    g_loaderWake.notify_one();
+    if (g_loaderThread.joinable())
+        g_loaderThread.join();
+    g_loaderQueue.clear();
 
+    {
+        ncnn::MutexLockGuard g(lock);
 
-        delete g_nanodet;
-        g_nanodet = 0;
+        g_nanodet.reset();
+        g_segmenter.reset();
+        g_asyncDetector.set_model(g_nanodet);
     }
 
     delete g_camera;
@@ -202,40 +575,529 @@ JNIEXPORT jboolean JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_load
 
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "loadModel %p", mgr);
 
-    // Define the model type, target size, mean values, and normalization values for "ELite1_416"
-    const char* modeltype = "ELite1_416";
-    const int target_size = 416;
-    const float mean_vals[3] = {127.f, 127.f, 127.f};
-    const float norm_vals[3] = {1.f / 128.f, 1.f / 128.f, 1.f / 128.f};
+    // Assets, preprocessing and decoder of the model
+    const ModelManifest* manifest = find_model_manifest(MODEL_TYPE);
+    if (!manifest)
+    {
+        return JNI_FALSE;
+    }
     bool use_gpu = (int)cpugpu == 1;
 
-    // Reload the model
+    // Already resident or loading with the same configuration, nothing to do
+    std::shared_ptr<NanoDet> target;
+    int generation;
+    bool hot_swap;
     {
         ncnn::MutexLockGuard g(lock);
 
-        // Check if GPU is requested but not available
-        if (use_gpu && ncnn::get_gpu_count() == 0)
+        if (g_requestedCpuGpu == (int)cpugpu && (g_nanodet || g_pendingLoads > 0))
         {
-            // No GPU available
-            delete g_nanodet;
-            g_nanodet = 0;
+            return JNI_TRUE;
         }
-        else
+
+        // Switching back to the resident configuration before the pending load finished, supersede that load
+        if (g_nanodet && g_residentCpuGpu == (int)cpugpu)
+        {
+            g_requestedCpuGpu = (int)cpugpu;
+            ++g_loadGeneration;
+            return JNI_TRUE;
+        }
+
+        g_requestedCpuGpu = (int)cpugpu;
+        generation = ++g_loadGeneration;
+        g_pendingLoads++;
+
+        target = std::make_shared<NanoDet>();
+
+        if (!g_assetManagerRef)
+            g_assetManagerRef = env->NewGlobalRef(assetManager);
+        mgr = AAssetManager_fromJava(env, g_assetManagerRef);
+
+        hot_swap = (bool)g_nanodet;
+    }
+
+    // Check if GPU is requested but not available
+    if (use_gpu && ncnn::get_gpu_count() == 0)
+    {
+        // No GPU available
+        target.reset();
+    }
+
+    // Build and warm the new model without holding the render lock, then swap it in between frames
+    // Returns false if the model could not be loaded and the current one was kept
+    std::function<bool()> load_and_swap = [=]() mutable
+    {
+        // Queued loads of configurations that were requested again in between are skipped
+        {
+            ncnn::MutexLockGuard g(lock);
+            if (generation != g_loadGeneration)
+            {
+                g_pendingLoads--;
+                return true;
+            }
+        }
+
+        const bool failed = target && target->load(mgr, *manifest, use_gpu) != 0;
+        if (failed)
+        {
+            __android_log_print(ANDROID_LOG_ERROR, "ncnn", "loading %s failed, keeping the current model", manifest->name);
+            target.reset();
+        }
+
+        std::shared_ptr<NanoDet> retired;
+        {
+            ncnn::MutexLockGuard g(lock);
+            g_pendingLoads--;
+
+            // A newer request superseded this one while it loaded, the instance is dropped
+            if (generation != g_loadGeneration)
+                return !failed;
+
+            if (failed)
+            {
+                // Let the next request with this configuration try again
+                g_requestedCpuGpu = g_residentCpuGpu;
+                return false;
+            }
+
+            if (target && g_nanodet)
+                target->adopt_tracking_state(*g_nanodet);
+            if (target)
+                target->set_output_plan(detect_mode_heads(g_detectMode));
+
+            // The render loop only ever sees a complete model. The previous instance is released below, outside
+            // the lock, unless the executor still holds it for a forward pass
+            retired = g_nanodet;
+            g_nanodet = target;
+            g_asyncDetector.set_model(g_nanodet);
+            g_residentCpuGpu = g_nanodet ? g_requestedCpuGpu : -1;
+
+            // Run the new model on the next frame, the previous detections stay on screen until then
+            g_motionGate.reset();
+            g_cpuPolicy.reset(g_nanodet && g_nanodet->uses_gpu());
+        }
+
+        __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "model swapped in, generation %d", generation);
+        return true;
+    };
+
+    if (hot_swap)
+    {
+        // The caller is the UI thread, queue the load and return without waiting for an earlier one
         {
-            // Load the model
-            if (!g_nanodet)
-                g_nanodet = new NanoDet;
-            g_nanodet->load(mgr, modeltype, target_size, mean_vals, norm_vals, use_gpu);
+            std::lock_guard<std::mutex> g(g_loaderMutex);
+            if (g_loaderStopping)
+                return JNI_FALSE;
+            if (!g_loaderThread.joinable())
+                g_loaderThread = std::thread(run_loader);
+            g_loaderQueue.push_back(load_and_swap);
         }
+        g_loaderWake.notify_one();
+    }
+    else if (!load_and_swap())
+    {
+        return JNI_FALSE;
     }
 
     return JNI_TRUE;
 }
 
+// Load the model if needed and register one more user of it
+JNIEXPORT jboolean JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_acquireModel(JNIEnv* env, jobject thiz, jobject assetManager, jint cpugpu)
+{
+    jboolean ret = Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_loadModel(env, thiz, assetManager, cpugpu);
+
+    ncnn::MutexLockGuard g(lock);
+    if (ret == JNI_TRUE)
+        g_modelRefs++;
+
+    return ret;
+}
+
+// Unregister a user, the model stays resident so the next screen finds it loaded
+JNIEXPORT void JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_releaseModel(JNIEnv* env, jobject thiz)
+{
+    ncnn::MutexLockGuard g(lock);
+    if (g_modelRefs > 0)
+        g_modelRefs--;
+}
+
+// Free the model when no screen uses it, returns true if memory was released
+JNIEXPORT jboolean JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_trimModel(JNIEnv* env, jobject thiz)
+{
+    // Nets are destroyed after the lock is released
+    std::shared_ptr<NanoDet> released;
+    std::shared_ptr<Segmenter> segmenter;
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        // The model only goes when no screen holds it, an executor finishing a frame on it keeps it alive until done
+        if (g_modelRefs == 0 && g_pendingLoads == 0)
+        {
+            released.swap(g_nanodet);
+            g_asyncDetector.set_model(g_nanodet);
+            segmenter.swap(g_segmenter);
+            g_segmentationWorker.set_segmenter(g_segmenter);
+            g_segmentationWorker.clear();
+            g_segmentationEnabled = false;
+            g_residentCpuGpu = -1;
+            g_requestedCpuGpu = -1;
+            g_lastObjects.clear();
+        }
+    }
+
+    if (!released)
+        return JNI_FALSE;
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "trimModel released the model");
+
+    return JNI_TRUE;
+}
+
 JNIEXPORT jfloat JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getFps(JNIEnv* env, jobject thiz) {
     return global_fps;
 }
 
+// Enable or disable skipping inference on static scenes
+JNIEXPORT void JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_setMotionGateEnabled(JNIEnv* env, jobject thiz, jboolean enabled) {
+    ncnn::MutexLockGuard g(lock);
+    g_motionGate.enabled = enabled == JNI_TRUE;
+}
+
+// Fraction of camera frames that reused the previous detections (0..1)
+JNIEXPORT jfloat JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getMotionGateSkipRate(JNIEnv* env, jobject thiz) {
+    ncnn::MutexLockGuard g(lock);
+    return g_motionGate.skip_rate();
+}
+
+// Estimated inference CPU time saved by the gate, in milliseconds
+JNIEXPORT jfloat JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getMotionGateSavedMs(JNIEnv* env, jobject thiz) {
+    ncnn::MutexLockGuard g(lock);
+    return (jfloat)g_motionGate.saved_ms();
+}
+
+// Thread count currently used by the forward pass
+JNIEXPORT jint JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getInferenceThreads(JNIEnv* env, jobject thiz) {
+    ncnn::MutexLockGuard g(lock);
+    return g_cpuPolicy.inference_threads();
+}
+
+// CPU topology, chosen thread count and measured scaling efficiency per thread count
+JNIEXPORT jstring JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getCpuPolicyMetrics(JNIEnv* env, jobject thiz) {
+    std::string metrics;
+    {
+        ncnn::MutexLockGuard g(lock);
+        metrics = g_cpuPolicy.metrics();
+    }
+    return env->NewStringUTF(metrics.c_str());
+}
+
+// Cold start timings of the loaded model: asset load, warm-up pass and whether the weights are mapped in place
+JNIEXPORT jstring JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getModelLoadMetrics(JNIEnv* env, jobject thiz) {
+    char metrics[128] = "";
+    {
+        ncnn::MutexLockGuard g(lock);
+        if (g_nanodet)
+            sprintf(metrics, "load=%.1fms warmup=%.1fms zerocopy=%d", g_nanodet->getModelLoadMs(), g_nanodet->getWarmUpMs(),
+                    g_nanodet->isModelZeroCopy());
+    }
+    return env->NewStringUTF(metrics);
+}
+
+// Run the on-device surface segmentation beside detection, returns false when the model is not available
+JNIEXPORT jboolean JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_setSegmentationEnabled(JNIEnv* env, jobject thiz, jboolean enabled) {
+    std::shared_ptr<Segmenter> segmenter;
+    AAssetManager* mgr = 0;
+    {
+        ncnn::MutexLockGuard g(lock);
+        g_surfaceZones.valid = false;
+        g_segmentationWorker.clear();
+        if (enabled != JNI_TRUE || g_segmenter) {
+            g_segmentationEnabled = enabled == JNI_TRUE;
+            return JNI_TRUE;
+        }
+
+        // The asset manager is registered by loadModel
+        if (!g_assetManagerRef || g_segmenterMissing)
+            return JNI_FALSE;
+        mgr = AAssetManager_fromJava(env, g_assetManagerRef);
+    }
+
+    // The segmentation model is optional, builds without it never enable the stage
+    if (!Segmenter::available(mgr, "surface")) {
+        __android_log_print(ANDROID_LOG_INFO, "ncnn", "segmentation assets not bundled, surface zones disabled");
+        ncnn::MutexLockGuard g(lock);
+        g_segmenterMissing = true;
+        return JNI_FALSE;
+    }
+
+    // Load without holding the render lock
+    const float mean_vals[3] = {123.675f, 116.28f, 103.53f};
+    const float norm_vals[3] = {1.f / 58.395f, 1.f / 57.12f, 1.f / 57.375f};
+    segmenter = std::make_shared<Segmenter>();
+    if (segmenter->load(mgr, "surface", 128, 160, mean_vals, norm_vals) != 0)
+        return JNI_FALSE;
+
+    ncnn::MutexLockGuard g(lock);
+    if (!g_segmenter) {
+        g_segmenter = segmenter;
+        g_segmentationWorker.set_segmenter(g_segmenter);
+    }
+    g_segmentationEnabled = true;
+    return JNI_TRUE;
+}
+
+// Surface zones of the last segmentation, 27 floats: walkable share of the 9 zones, their dominant surface label
+// and the share of that surface. Empty when segmentation is off or has no result yet
+JNIEXPORT jfloatArray JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getSurfaceZones(JNIEnv* env, jobject thiz) {
+    float values[27];
+    bool valid;
+    {
+        ncnn::MutexLockGuard g(lock);
+        valid = g_segmentationEnabled && g_surfaceZones.valid;
+        for (int z = 0; z < 9 && valid; z++) {
+            values[z] = g_surfaceZones.walkable[z];
+            values[9 + z] = (float)g_surfaceZones.dominant[z];
+            values[18 + z] = g_surfaceZones.dominant_share[z];
+        }
+    }
+
+    jfloatArray result = env->NewFloatArray(valid ? 27 : 0);
+    if (valid)
+        env->SetFloatArrayRegion(result, 0, 27, values);
+    return result;
+}
+
+// Throughput of detect_parallel against sequential detect calls for batch sizes 1, 2, 4 ... max_batch.
+// Runs a separate CPU instance of the model so the preview keeps running, call it off the main thread
+static std::string run_parallel_benchmark(NanoDet& detector, const cv::Mat& frame, int max_batch, int loops)
+{
+    std::string report;
+    char line[160];
+
+    for (int batch = 1; batch <= max_batch; batch *= 2)
+    {
+        std::vector<cv::Mat> frames(batch, frame);
+        std::vector<Object> objects;
+        std::vector<std::vector<Object> > results;
+
+        // One untimed round so the allocators have settled
+        detector.detect(frame, objects);
+
+        double start = ncnn::get_current_time();
+        for (int l = 0; l < loops; l++)
+        {
+            for (int b = 0; b < batch; b++)
+            {
+                detector.detect(frames[b], objects);
+            }
+        }
+        const double sequential_ms = ncnn::get_current_time() - start;
+
+        // Frame-level parallelism, one single-threaded extractor per frame on the shared weights
+        std::vector<DetectWorker> workers(batch);
+        detector.detect_parallel(frames, results, workers.data(), batch);
+
+        start = ncnn::get_current_time();
+        for (int l = 0; l < loops; l++)
+        {
+            detector.detect_parallel(frames, results, workers.data(), batch);
+        }
+        const double parallel_ms = ncnn::get_current_time() - start;
+
+        const double frames_total = (double)batch * loops;
+        sprintf(line, "batch %d: sequential %.1f fps, parallel %.1f fps (%.2fx)\n", batch,
+                frames_total * 1000.0 / sequential_ms, frames_total * 1000.0 / parallel_ms, sequential_ms / parallel_ms);
+        report += line;
+    }
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "parallel benchmark\n%s", report.c_str());
+
+    return report;
+}
+
+// Forward time of every detection mode's output plan, with the number of objects each plan still finds
+static std::string run_head_plan_benchmark(NanoDet& detector, const cv::Mat& frame, int loops)
+{
+    std::string report;
+    char line[160];
+
+    const int modes[] = {DETECT_MODE_FULL, DETECT_MODE_NAVIGATION};
+    const char* mode_names[] = {"full", "navigation"};
+    double full_ms = 0.0;
+    for (int m = 0; m < 2; m++)
+    {
+        detector.set_output_plan(detect_mode_heads(modes[m]));
+
+        std::vector<Object> objects;
+        detector.detect(frame, objects);
+
+        double start = ncnn::get_current_time();
+        for (int l = 0; l < loops; l++)
+        {
+            detector.detect(frame, objects);
+        }
+        const double ms = (ncnn::get_current_time() - start) / loops;
+        if (m == 0)
+            full_ms = ms;
+
+        sprintf(line, "%s: heads %d, %.2f ms per frame (%.2fx), %d objects\n", mode_names[m], detect_mode_heads(modes[m]),
+                ms, full_ms / ms, (int)objects.size());
+        report += line;
+    }
+
+    detector.set_output_plan(DETECT_HEAD_ALL);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "head plan benchmark\n%s", report.c_str());
+
+    return report;
+}
+
+// Same class and IoU of at least 0.5, the measure used to compare decoders against the shipped model
+static int count_matches(const std::vector<Object>& reference, const std::vector<Object>& objects)
+{
+    std::vector<bool> used(reference.size(), false);
+    int matches = 0;
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        for (size_t r = 0; r < reference.size(); r++)
+        {
+            if (used[r] || reference[r].label != objects[i].label)
+                continue;
+
+            const float inter = (reference[r].rect & objects[i].rect).area();
+            const float uni = reference[r].rect.area() + objects[i].rect.area() - inter;
+            if (uni > 0.f && inter / uni >= 0.5f)
+            {
+                used[r] = true;
+                matches++;
+                break;
+            }
+        }
+    }
+    return matches;
+}
+
+// Latency of every bundled model of the manifest table and how well its detections agree with the pipeline model.
+// This is not accuracy, there are no labelled frames on the device and the reference is itself a detector output:
+// "agreement recall vs reference" is the share of the pipeline model's objects found again, "agreement precision
+// vs reference" the share of the model's own objects the pipeline model confirms. The pipeline model agrees with itself
+static std::string run_decoder_benchmark(AAssetManager* mgr, const cv::Mat& frame, int loops)
+{
+    std::string report;
+    char line[256];
+
+    std::vector<Object> reference;
+    {
+        NanoDet detector;
+        if (detector.load(mgr, *find_model_manifest(MODEL_TYPE), false) == 0)
+            detector.detect(frame, reference);
+    }
+
+    for (int m = 0; m < model_manifest_count(); m++)
+    {
+        const ModelManifest& manifest = model_manifest(m);
+        NanoDet detector;
+        if (detector.load(mgr, manifest, false) != 0)
+        {
+            sprintf(line, "%s (%s): not bundled\n", manifest.name, head_decoder(manifest.decoder)->name());
+            report += line;
+            continue;
+        }
+
+        std::vector<Object> objects;
+        double start = ncnn::get_current_time();
+        for (int l = 0; l < loops; l++)
+        {
+            detector.detect(frame, objects);
+        }
+        const double ms = (ncnn::get_current_time() - start) / loops;
+
+        const int matches = count_matches(reference, objects);
+        sprintf(line, "%s (%s): %.2f ms per frame, %d objects, agreement recall vs reference %.2f, agreement precision vs reference %.2f\n", manifest.name, detector.head()->name(), ms,
+                (int)objects.size(), reference.empty() ? 1.f : (float)matches / reference.size(), objects.empty() ? 1.f : (float)matches / objects.size());
+        report += line;
+    }
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "decoder benchmark\n%s", report.c_str());
+
+    return report;
+}
+
+// Load a separate CPU instance of the model for the benchmarks, the preview keeps its own
+static bool load_benchmark_detector(JNIEnv* env, NanoDet& detector)
+{
+    AAssetManager* mgr = 0;
+    {
+        ncnn::MutexLockGuard g(lock);
+        if (g_assetManagerRef)
+            mgr = AAssetManager_fromJava(env, g_assetManagerRef);
+    }
+    if (!mgr)
+        return false;
+
+    return detector.load(mgr, *find_model_manifest(MODEL_TYPE), false) == 0;
+}
+
+// Benchmark on the live camera view when there is one, detections change the cost of the decoding
+static cv::Mat benchmark_frame()
+{
+    cv::Mat rgb;
+    cv::Mat nv21 = g_camera ? g_camera->get_latest_frame() : cv::Mat();
+    if (!nv21.empty())
+    {
+        cv::cvtColor(nv21, rgb, cv::COLOR_YUV2RGB_NV21);
+    }
+    else
+    {
+        rgb.create(640, 480, CV_8UC3);
+        cv::randu(rgb, cv::Scalar::all(0), cv::Scalar::all(255));
+    }
+    return rgb;
+}
+
+JNIEXPORT jstring JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_runParallelBenchmark(JNIEnv* env, jobject thiz, jint maxBatch, jint loops) {
+    NanoDet detector;
+    if (maxBatch < 1 || loops < 1 || !load_benchmark_detector(env, detector))
+        return env->NewStringUTF("");
+
+    std::string report = run_parallel_benchmark(detector, benchmark_frame(), maxBatch, loops);
+    return env->NewStringUTF(report.c_str());
+}
+
+JNIEXPORT jstring JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_runHeadPlanBenchmark(JNIEnv* env, jobject thiz, jint loops) {
+    NanoDet detector;
+    if (loops < 1 || !load_benchmark_detector(env, detector))
+        return env->NewStringUTF("");
+
+    std::string report = run_head_plan_benchmark(detector, benchmark_frame(), loops);
+    return env->NewStringUTF(report.c_str());
+}
+
+JNIEXPORT jstring JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_runDecoderBenchmark(JNIEnv* env, jobject thiz, jint loops) {
+    AAssetManager* mgr = 0;
+    {
+        ncnn::MutexLockGuard g(lock);
+        if (g_assetManagerRef)
+            mgr = AAssetManager_fromJava(env, g_assetManagerRef);
+    }
+    if (!mgr || loops < 1)
+        return env->NewStringUTF("");
+
+    std::string report = run_decoder_benchmark(mgr, benchmark_frame(), loops);
+    return env->NewStringUTF(report.c_str());
+}
+
+// Select the output plan of the general detection, see DetectMode. Find queries always use every head
+JNIEXPORT void JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_setDetectionMode(JNIEnv* env, jobject thiz, jint mode) {
+    ncnn::MutexLockGuard g(lock);
+    g_detectMode = (int)mode;
+
+    // Only the synchronous passes read the plan of the model, the executor gets it with every frame
+    if (g_nanodet)
+        g_nanodet->set_output_plan(detect_mode_heads(g_detectMode));
+}
+
 //Manages camera opening and closing
 // public native boolean openCamera(int facing);
 JNIEXPORT jboolean JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_openCamera(JNIEnv* env, jobject thiz, jint facing)
@@ -265,6 +1127,9 @@ JNIEXPORT jboolean JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_open
 
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "Camera opened successfully");
 
+    const CameraIntrinsics& intrinsics = g_camera->stream_intrinsics();
+    g_streamFocalLengthPx = intrinsics.valid ? intrinsics.fx : 0.f;
+
     return JNI_TRUE; // Return true if the camera opened successfully
 }
 
@@ -297,126 +1162,433 @@ JNIEXPORT jboolean JNICALL Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_setO
 
 
 
-// Function to filter repetitive directions
-std::vector<std::string> filterDirections(const std::vector<std::string>& directions, int timeframeSeconds) {
-    std::vector<std::string> filteredDirections;
-    std::chrono::steady_clock::time_point lastLoggedTime = std::chrono::steady_clock::now() - std::chrono::seconds(timeframeSeconds);
+std::vector<std::string> g_trackAnnouncements;
+std::mutex g_trackAnnouncementsMutex;
+EventLog g_eventLog;
+SightingMemory g_sightings;
+std::vector<std::string> g_findDetections;
+std::vector<float> g_findHits;
 
-    for (const auto& direction : directions) {
-        if (filteredDirections.empty() || direction != filteredDirections.back()) {
-            filteredDirections.push_back(direction);
-            lastLoggedTime = std::chrono::steady_clock::now();
-        } else {
-            auto now = std::chrono::steady_clock::now();
-            if (std::chrono::duration_cast<std::chrono::seconds>(now - lastLoggedTime).count() >= timeframeSeconds) {
-                filteredDirections.push_back(direction);
-                lastLoggedTime = now;
-            }
-        }
+// Build a Java String[] from a vector of strings
+static jobjectArray toJavaStringArray(JNIEnv* env, const std::vector<std::string>& strings)
+{
+    jobjectArray result = env->NewObjectArray(strings.size(), env->FindClass("java/lang/String"), env->NewStringUTF(""));
+
+    for (size_t i = 0; i < strings.size(); ++i) {
+        env->SetObjectArrayElement(result, i, env->NewStringUTF(strings[i].c_str()));
     }
 
-    return filteredDirections;
+    return result;
 }
 
-std::vector<std::string> g_allDetections;
-std::vector<std::string> g_centerDetections;
-std::vector<std::string> g_MinNavDirections;
-std::vector<std::string> g_MaxNavDirections;
-
 extern "C"
 JNIEXPORT jobjectArray JNICALL
 Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getAllDetections(JNIEnv* env, jobject thiz)
 {
-    jobjectArray result = env->NewObjectArray(g_allDetections.size(), env->FindClass("java/lang/String"), env->NewStringUTF(""));
-
-    for (size_t i = 0; i < g_allDetections.size(); ++i) {
-        env->SetObjectArrayElement(result, i, env->NewStringUTF(g_allDetections[i].c_str()));
-    }
+    FrameResult frame;
+    g_frameSnapshots.read(frame);
 
-    return result;
+    std::vector<std::string> detections;
+    frame_detection_sentences(frame, detections);
+    return toJavaStringArray(env, detections);
 }
 
 extern "C"
 JNIEXPORT jobjectArray JNICALL
 Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getCenterDetections(JNIEnv* env, jobject thiz)
 {
-    jobjectArray result = env->NewObjectArray(g_centerDetections.size(), env->FindClass("java/lang/String"), env->NewStringUTF(""));
-
-    for (size_t i = 0; i < g_centerDetections.size(); ++i) {
-        env->SetObjectArrayElement(result, i, env->NewStringUTF(g_centerDetections[i].c_str()));
-    }
+    FrameResult frame;
+    g_frameSnapshots.read(frame);
 
-    return result;
+    std::vector<std::string> detections;
+    frame_center_sentences(frame, detections);
+    return toJavaStringArray(env, detections);
 }
 
 }
 
+// Directions of the last drawn frame for the screen, every call returns all of them.
+// Repeats are only held back on the speech path, by the announcement scheduler
 extern "C"
 JNIEXPORT jobjectArray JNICALL
 Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getMinNavDirections(JNIEnv* env, jobject thiz)
 {
-    // Filter repetitive directions
-    std::vector<std::string> filteredDirections = filterDirections(g_MinNavDirections, 6); // 6 seconds timeframe
+    FrameResult frame;
+    g_frameSnapshots.read(frame);
 
-    // Explicitly cast the size to jsize
-    jsize arraySize = static_cast<jsize>(filteredDirections.size());
+    std::vector<std::string> directions;
+    frame_min_nav_directions(frame, directions);
+    return toJavaStringArray(env, directions);
+}
 
-    jobjectArray result = env->NewObjectArray(arraySize, env->FindClass("java/lang/String"), env->NewStringUTF(""));
+extern "C"
+JNIEXPORT jobjectArray JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getMaxNavDirections(JNIEnv* env, jobject thiz)
+{
+    FrameResult frame;
+    g_frameSnapshots.read(frame);
 
-    for (jsize i = 0; i < arraySize; ++i) {
-        env->SetObjectArrayElement(result, i, env->NewStringUTF(filteredDirections[i].c_str()));
-    }
+    std::vector<std::string> directions;
+    frame_max_nav_directions(frame, directions);
+    return toJavaStringArray(env, directions);
+}
 
+// Writes the result of the last drawn frame into a direct ByteBuffer in the layout of frame_result_write.
+// Returns the number of bytes written, -1 if the buffer is not direct or too small for the header
+extern "C"
+JNIEXPORT jint JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getFrameResult(JNIEnv* env, jobject thiz, jobject buffer)
+{
+    void* data = env->GetDirectBufferAddress(buffer);
+    const jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (!data || capacity < 0)
+        return -1;
+
+    FrameResult frame;
+    g_frameSnapshots.read(frame);
+    return frame_result_write(frame, data, (size_t)capacity);
+}
+
+// Returns the heading of the last drawn frame as {heading, free valley width, density ahead}: the heading and the
+// width in degrees with positive headings to the right, a width of 0 when every direction is blocked and the
+// density from 0 when the way ahead is free to 1 for an obstacle at the camera. Empty before the first general frame
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getHeading(JNIEnv* env, jobject thiz)
+{
+    FrameResult frame;
+    if (g_frameSnapshots.read(frame) == 0 || frame.direction == NAV_UNKNOWN)
+        return env->NewFloatArray(0);
+
+    const float rad_to_deg = 180.f / 3.14159265f;
+    const float heading[3] = { frame.heading * rad_to_deg, frame.heading_width * rad_to_deg, frame.heading_ahead };
+    jfloatArray result = env->NewFloatArray(3);
+    env->SetFloatArrayRegion(result, 0, 3, heading);
     return result;
 }
 
 extern "C"
 JNIEXPORT jobjectArray JNICALL
-Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getMaxNavDirections(JNIEnv* env, jobject thiz)
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getAllFindDetections(JNIEnv* env, jobject thiz, jstring objectName)
 {
-    // Filter repetitive directions
-    std::vector<std::string> filteredDirections = filterDirections(g_MaxNavDirections, 10); // 10 seconds timeframe
+    const char* object_name_cstr = env->GetStringUTFChars(objectName, nullptr);
+    std::string object_name(object_name_cstr);
+    env->ReleaseStringUTFChars(objectName, object_name_cstr);
 
-    // Explicitly cast the size to jsize
-    jsize arraySize = static_cast<jsize>(filteredDirections.size());
+    // Queries naming a class the model knows switch the render loop to find mode, which decodes that class
+    // from the outputs of the general detection
+    const int class_id = nanodet_query_class_id(object_name);
 
-    jobjectArray result = env->NewObjectArray(arraySize, env->FindClass("java/lang/String"), env->NewStringUTF(""));
+    std::vector<std::string> filtered_detections;
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        if (class_id >= 0 && class_id == g_findClassId) {
+            // Find mode is already running for this class, its results only hold the hits
+            g_findLastQueryMs = ncnn::get_current_time();
+            filtered_detections = g_findDetections;
+        } else {
+            // Filter detections based on the object name
+            FrameResult frame;
+            g_frameSnapshots.read(frame);
+
+            // Match the class name the query resolved to, and the query text as typed otherwise
+            const std::string needle = class_id >= 0 ? nanodet_class_name(class_id) : object_name;
+            std::vector<std::string> detections;
+            frame_detection_sentences(frame, detections);
+            for (const auto& detection : detections) {
+                if (detection.find(needle) != std::string::npos) {
+                    filtered_detections.push_back(detection);
+                }
+            }
 
-    for (jsize i = 0; i < arraySize; ++i) {
-        env->SetObjectArrayElement(result, i, env->NewStringUTF(filteredDirections[i].c_str()));
+            // Start or leave find mode, the previous detections must not be republished for another class
+            if (class_id != g_findClassId) {
+                g_findClassId = class_id;
+                g_findDetections.clear();
+                g_findHits.clear();
+                g_lastFindObjects.clear();
+                g_motionGate.reset();
+            }
+            g_findLastQueryMs = ncnn::get_current_time();
+        }
     }
 
+    return toJavaStringArray(env, filtered_detections);
+}
+
+// Leave find mode and go back to the general detection
+extern "C"
+JNIEXPORT void JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_clearFindTarget(JNIEnv* env, jobject thiz)
+{
+    ncnn::MutexLockGuard g(lock);
+    if (g_findClassId >= 0) {
+        g_findClassId = -1;
+        g_lastFindObjects.clear();
+        g_motionGate.reset();
+    }
+}
+
+// Returns the hits of the running find query, FIND_HIT_STRIDE floats per hit:
+// label, probability, x, y, width, height, zone index (row * 3 + col, -1 if unknown), distance in meters
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getFindHits(JNIEnv* env, jobject thiz)
+{
+    std::vector<float> hits;
+    {
+        ncnn::MutexLockGuard g(lock);
+        hits = g_findHits;
+    }
+
+    jfloatArray result = env->NewFloatArray(hits.size());
+    if (!hits.empty())
+        env->SetFloatArrayRegion(result, 0, hits.size(), hits.data());
+
     return result;
 }
 
+// Run the general detection on the executor thread instead of the render thread, the preview then keeps its
+// frame rate and shows the boxes of the newest finished frame
+extern "C"
+JNIEXPORT void JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_setAsyncDetectionEnabled(JNIEnv* env, jobject thiz, jboolean enabled)
+{
+    {
+        ncnn::MutexLockGuard g(lock);
+        g_asyncEnabled = enabled == JNI_TRUE;
+        g_asyncResultReady = false;
+        if (g_asyncEnabled)
+            g_asyncDetector.set_model(g_nanodet);
+    }
+
+    if (enabled != JNI_TRUE)
+        g_asyncDetector.cancel();
+}
+
+// Register the listener receiving the detection sentences of every frame with fresh detections, null removes it.
+// The listener is called on the camera thread and should hand the results over to its own dispatcher
+extern "C"
+JNIEXPORT void JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_setDetectionListener(JNIEnv* env, jobject thiz, jobject listener)
+{
+    ncnn::MutexLockGuard g(g_listenerLock);
+
+    if (g_detectionListener) {
+        env->DeleteGlobalRef(g_detectionListener);
+        g_detectionListener = 0;
+        g_onDetections = 0;
+    }
+
+    if (listener) {
+        jclass listener_class = env->GetObjectClass(listener);
+        g_onDetections = env->GetMethodID(listener_class, "onDetections", "([Ljava/lang/String;)V");
+        env->DeleteLocalRef(listener_class);
+        if (g_onDetections)
+            g_detectionListener = env->NewGlobalRef(listener);
+    }
+
+    g_detectionListening = g_detectionListener != 0;
+}
+
+// Register the listener speaking the obstacle guidance, null removes it. mode is an AnnounceMode.
+// The scheduler runs on every drawn frame and calls the listener on the camera thread as soon as an announcement is due
+extern "C"
+JNIEXPORT void JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_setAnnouncementListener(JNIEnv* env, jobject thiz, jobject listener, jint mode)
+{
+    ncnn::MutexLockGuard g(g_listenerLock);
+
+    if (g_announcementListener) {
+        env->DeleteGlobalRef(g_announcementListener);
+        g_announcementListener = 0;
+        g_onAnnouncement = 0;
+    }
+
+    if (listener) {
+        jclass listener_class = env->GetObjectClass(listener);
+        g_onAnnouncement = env->GetMethodID(listener_class, "onAnnouncement", "(Ljava/lang/String;Z)V");
+        env->DeleteLocalRef(listener_class);
+        if (g_onAnnouncement)
+            g_announcementListener = env->NewGlobalRef(listener);
+    }
+
+    g_announcer.set_mode(mode);
+    g_announcing = g_announcementListener != 0;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_setTrackLastKnownPosition(JNIEnv* env, jobject thiz, jboolean enabled)
+{
+    ncnn::MutexLockGuard g(lock);
+    g_trackingEnabled = enabled == JNI_TRUE;
+}
+
+// Size of the occupancy grid fusing obstacles over time and the half-life of its evidence in milliseconds.
+// Longer half-lives give steadier directions but react later to obstacles that moved away
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_configureOccupancyGrid(JNIEnv* env, jobject thiz, jint cols, jint rows, jfloat halfLifeMs)
+{
+    if (cols < 1 || cols > OCCUPANCY_MAX_COLS || rows < 1 || rows > OCCUPANCY_MAX_ROWS || halfLifeMs <= 0.f)
+        return JNI_FALSE;
+
+    ncnn::MutexLockGuard g(lock);
+    g_occupancyCols = cols;
+    g_occupancyRows = rows;
+    g_occupancyHalfLifeMs = halfLifeMs;
+    g_occupancyConfigChanged = true;
+    return JNI_TRUE;
+}
+
+// Between periodic full-frame passes, detect only in crops around the tracked objects. Takes effect while tracking runs
+extern "C"
+JNIEXPORT void JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_setRoiRedetectionEnabled(JNIEnv* env, jobject thiz, jboolean enabled)
+{
+    ncnn::MutexLockGuard g(lock);
+    g_roiRedetectionEnabled = enabled == JNI_TRUE;
+}
+
+// Number and average duration of the full-frame and crop passes of the loaded model
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getRoiMetrics(JNIEnv* env, jobject thiz)
+{
+    std::string metrics;
+    {
+        ncnn::MutexLockGuard g(lock);
+        if (g_nanodet)
+            metrics = g_nanodet->getRoiMetrics();
+    }
+    return env->NewStringUTF(metrics.c_str());
+}
+
 extern "C"
 JNIEXPORT jobjectArray JNICALL
-Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getAllFindDetections(JNIEnv* env, jobject thiz, jstring objectName)
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getTrackedObjects(JNIEnv* env, jobject thiz)
+{
+    FrameResult frame;
+    g_frameSnapshots.read(frame);
+
+    std::vector<std::string> tracked;
+    frame_track_sentences(frame, tracked);
+
+    return toJavaStringArray(env, tracked);
+}
+
+// Returns the track changes since the previous call, each change is returned only once
+extern "C"
+JNIEXPORT jobjectArray JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getTrackAnnouncements(JNIEnv* env, jobject thiz)
+{
+    std::vector<std::string> announcements;
+    {
+        std::lock_guard<std::mutex> guard(g_trackAnnouncementsMutex);
+        announcements.swap(g_trackAnnouncements);
+    }
+
+    return toJavaStringArray(env, announcements);
+}
+
+// Writes the track changes from fromSequence on into a direct ByteBuffer in the layout of EventLog::write. The header
+// tells the sequence to continue from and whether older events were already overwritten. Events are produced while
+// tracking runs. Returns the number of bytes written, -1 if the buffer is not direct or too small for the header
+extern "C"
+JNIEXPORT jint JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getDeltaEvents(JNIEnv* env, jobject thiz, jint fromSequence, jobject buffer)
+{
+    void* data = env->GetDirectBufferAddress(buffer);
+    const jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (!data || capacity < 0)
+        return -1;
+
+    return g_eventLog.write((unsigned int)fromSequence, data, (size_t)capacity);
+}
+
+// Returns the last grid zone an object class was tracked in, or an empty string if it was never seen
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getLastKnownPosition(JNIEnv* env, jobject thiz, jstring objectName)
 {
     const char* object_name_cstr = env->GetStringUTFChars(objectName, nullptr);
     std::string object_name(object_name_cstr);
     env->ReleaseStringUTFChars(objectName, object_name_cstr);
 
-    // Filter detections based on the object name
-    std::vector<std::string> filtered_detections;
-    for (const auto& detection : g_allDetections) {
-        if (detection.find(object_name) != std::string::npos) {
-            filtered_detections.push_back(detection);
-        }
+    const int label = nanodet_class_id(object_name);
+
+    int zone = ZONE_OUT_OF_BOUNDS;
+    {
+        ncnn::MutexLockGuard g(lock);
+        if (g_nanodet)
+            zone = g_nanodet->getLastKnownZone(label);
     }
 
-    // Create a new Java string array to return the filtered detections
-    jobjectArray result = env->NewObjectArray(filtered_detections.size(), env->FindClass("java/lang/String"), env->NewStringUTF(""));
+    return env->NewStringUTF(zone == ZONE_OUT_OF_BOUNDS ? "" : grid_zone_name(zone));
+}
 
-    for (size_t i = 0; i < filtered_detections.size(); ++i) {
-        env->SetObjectArrayElement(result, i, env->NewStringUTF(filtered_detections[i].c_str()));
+// Returns the last sightings of an object class, newest first, SIGHTING_STRIDE floats per sighting:
+// age in milliseconds, zone index (row * 3 + col), distance in meters, box x, y, width and height as
+// fractions of the frame and the detection score. Empty if the class was never seen
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getLastSightings(JNIEnv* env, jobject thiz, jstring objectName)
+{
+    const char* object_name_cstr = env->GetStringUTFChars(objectName, nullptr);
+    const int label = nanodet_class_id(object_name_cstr);
+    env->ReleaseStringUTFChars(objectName, object_name_cstr);
+
+    Sighting sightings[SIGHTINGS_PER_CLASS];
+    const int count = g_sightings.read(label, sightings, SIGHTINGS_PER_CLASS);
+    const double now = ncnn::get_current_time();
+
+    float values[SIGHTINGS_PER_CLASS * SIGHTING_STRIDE];
+    for (int i = 0; i < count; i++) {
+        const Sighting& sighting = sightings[i];
+        float* v = values + i * SIGHTING_STRIDE;
+        v[0] = (float)(now - sighting.timestamp_ms);
+        v[1] = (float)sighting.zone;
+        v[2] = sighting.distance;
+        v[3] = sighting.x;
+        v[4] = sighting.y;
+        v[5] = sighting.w;
+        v[6] = sighting.h;
+        v[7] = sighting.prob;
     }
 
+    jfloatArray result = env->NewFloatArray(count * SIGHTING_STRIDE);
+    if (count > 0)
+        env->SetFloatArrayRegion(result, 0, count * SIGHTING_STRIDE, values);
+
     return result;
 }
 
+// Returns "<class> last seen <age> ago at <zone>. <steps>" for the newest sighting of an object class,
+// or an empty string if it was never seen. Answers at once while a find query searches the live frames
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getLastSeen(JNIEnv* env, jobject thiz, jstring objectName)
+{
+    const char* object_name_cstr = env->GetStringUTFChars(objectName, nullptr);
+    const int label = nanodet_class_id(object_name_cstr);
+    env->ReleaseStringUTFChars(objectName, object_name_cstr);
+
+    Sighting sighting;
+    if (g_sightings.read(label, &sighting, 1) == 0)
+        return env->NewStringUTF("");
+
+    std::string text;
+    sighting_sentence(label, sighting, ncnn::get_current_time(), text);
+    return env->NewStringUTF(text.c_str());
+}
+
 extern "C" JNIEXPORT jbyteArray JNICALL
 Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getLatestFrame(JNIEnv* env, jobject thiz) {
+    // Encoding is auxiliary work, keep it off the cores running inference until this call returns
+    LittleCoreScope little_cores;
+
     // Get the latest frame
     cv::Mat frame = g_camera->get_latest_frame();
 
@@ -493,5 +1665,5 @@ Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getLatestFrame(JNIEnv* env, job
 extern "C"
 JNIEXPORT jfloat JNICALL
 Java_ie_tus_himbavision_jnibridge_HimbaJNIBridge_getFocalLengthPx(JNIEnv* env, jobject thiz) {
-    return globalFocalLengthPx;
+    return g_streamFocalLengthPx;
 }
@@ -15,6 +15,9 @@
 #include "../header/ndkcamera.h"
 
 #include <string>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 
 #include <android/log.h>
 
@@ -22,6 +25,10 @@
 
 #include "mat.h"
 
+// Size of the camera stream
+static const int STREAM_WIDTH = 640;
+static const int STREAM_HEIGHT = 480;
+
 // Global static variables for storing the latest camera frame and synchronizing access to it
 static cv::Mat newlatest_frame; // Latest captured frame (global storage)
 static std::mutex newframe_mutex; // Mutex to protect access to the frame
@@ -199,10 +206,11 @@ NdkCamera::NdkCamera()
     capture_session_output = 0;
     capture_session = 0;
 
+    stream_camera_intrinsics.valid = false;
 
     // setup imagereader and its surface
     {
-        AImageReader_new(640, 480, AIMAGE_FORMAT_YUV_420_888, /*maxImages*/2, &image_reader);
+        AImageReader_new(STREAM_WIDTH, STREAM_HEIGHT, AIMAGE_FORMAT_YUV_420_888, /*maxImages*/2, &image_reader);
 
         AImageReader_ImageListener listener;
         listener.context = this;
@@ -327,6 +335,17 @@ int NdkCamera::open(int _camera_facing)
     }
     __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "Selected Camera ID: %s", camera_id.c_str());
 
+    // Intrinsics of the stream from the opened camera, the frame path only reads them
+    {
+        ACameraMetadata* camera_metadata = nullptr;
+        if (ACameraManager_getCameraCharacteristics(camera_manager, camera_id.c_str(), &camera_metadata) == ACAMERA_OK) {
+            camera_stream_intrinsics(camera_metadata, STREAM_WIDTH, STREAM_HEIGHT, stream_camera_intrinsics);
+            ACameraMetadata_free(camera_metadata);
+        } else {
+            stream_camera_intrinsics.valid = false;
+        }
+    }
+
     // Step 3: Open camera
     {
         ACameraDevice_StateCallbacks camera_device_state_callbacks = {
@@ -597,6 +616,12 @@ NdkCameraWindow::NdkCameraWindow() : NdkCamera()
     win = 0;
 
     accelerometer_orientation = 0;
+    camera_pitch = 0.f;
+    camera_pitch_valid = false;
+
+    frame_camera_intrinsics.valid = false;
+    memset(frame_crop, 0, sizeof(frame_crop));
+    frame_stream_focal = 0.f;
 
     // sensor
     sensor_manager = ASensorManager_getInstance();
@@ -642,6 +667,10 @@ void NdkCameraWindow::set_window(ANativeWindow* _win)
     }
 }
 
+void NdkCameraWindow::on_image_luma(const unsigned char* y, int width, int height) const
+{
+}
+
 void NdkCameraWindow::on_image_render(cv::Mat& rgb) const
 {
 }
@@ -697,6 +726,19 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
                 {
                     accelerometer_orientation = 270;
                 }
+
+                // The back camera looks along -z, its tilt below the horizon follows from the share of gravity on z
+                const float g = sqrtf(acceleration_x * acceleration_x + acceleration_y * acceleration_y + acceleration_z * acceleration_z);
+                if (g > 1.f)
+                {
+                    float pitch = asinf(std::max(-1.f, std::min(1.f, acceleration_z / g)));
+                    if (camera_facing == 0)
+                        pitch = -pitch;
+
+                    // Smooth out hand shake, the raw accelerometer also measures the walking motion
+                    camera_pitch = camera_pitch_valid ? camera_pitch + 0.2f * (pitch - camera_pitch) : pitch;
+                    camera_pitch_valid = true;
+                }
             }
         }
     }
@@ -883,6 +925,16 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
         }
     }
 
+    // Follow the crop and rotation with the intrinsics of the frame fed to the detector
+    const int crop[5] = {nv21_roi_x, nv21_roi_y, nv21_roi_w, nv21_roi_h, rotate_type};
+    const float stream_focal = stream_camera_intrinsics.valid ? stream_camera_intrinsics.fx : 0.f;
+    if (memcmp(crop, frame_crop, sizeof(crop)) != 0 || stream_focal != frame_stream_focal)
+    {
+        frame_camera_intrinsics = crop_rotate_intrinsics(stream_camera_intrinsics, nv21_roi_x, nv21_roi_y, nv21_roi_w, nv21_roi_h, rotate_type);
+        memcpy(frame_crop, crop, sizeof(crop));
+        frame_stream_focal = stream_focal;
+    }
+
     // crop and rotate nv21
     cv::Mat nv21_croprotated(roi_h + roi_h / 2, roi_w, CV_8UC1);
     {
@@ -899,6 +951,8 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
     cv::Mat rgb(roi_h, roi_w, CV_8UC3);
     ncnn::yuv420sp2rgb(nv21_croprotated.data, roi_w, roi_h, rgb.data);
 
+    on_image_luma(nv21_croprotated.data, roi_w, roi_h);
+
     on_image_render(rgb);
 
     // rotate to native window orientation
@@ -951,43 +1005,6 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
 }
 
 
-float NdkCamera::getFocalLengthPX(ACameraManager* cameraManager, const char* cameraId) {
-    float focalLengthMM = 0.0f;
-    float sensorWidthMM = 0.0f;
-    int32_t imageWidthPX = 0;
-
-    ACameraMetadata* cameraMetadata = nullptr;
-    ACameraManager_getCameraCharacteristics(cameraManager, cameraId, &cameraMetadata);
-
-    // Get focal length in mm
-    ACameraMetadata_const_entry focalLengthEntry;
-    if (ACameraMetadata_getConstEntry(cameraMetadata, ACAMERA_LENS_INFO_AVAILABLE_FOCAL_LENGTHS, &focalLengthEntry) == ACAMERA_OK) {
-        focalLengthMM = focalLengthEntry.data.f[0];
-        __android_log_print(ANDROID_LOG_DEBUG, "CameraInfo", "Focal Length (mm): %f", focalLengthMM);
-    }
-
-    // Get sensor width in mm
-    ACameraMetadata_const_entry physicalSizeEntry;
-    if (ACameraMetadata_getConstEntry(cameraMetadata, ACAMERA_SENSOR_INFO_PHYSICAL_SIZE, &physicalSizeEntry) == ACAMERA_OK) {
-        sensorWidthMM = physicalSizeEntry.data.f[0];
-        __android_log_print(ANDROID_LOG_DEBUG, "CameraInfo", "Sensor Width (mm): %f", sensorWidthMM);
-    }
-
-    // Get image width in pixels
-    ACameraMetadata_const_entry pixelArraySizeEntry;
-    if (ACameraMetadata_getConstEntry(cameraMetadata, ACAMERA_SENSOR_INFO_PIXEL_ARRAY_SIZE, &pixelArraySizeEntry) == ACAMERA_OK) {
-        imageWidthPX = pixelArraySizeEntry.data.i32[0];
-        __android_log_print(ANDROID_LOG_DEBUG, "CameraInfo", "Image Width (px): %d", imageWidthPX);
-    }
-
-    ACameraMetadata_free(cameraMetadata);
-
-    // Calculate focal length in pixels
-    float focalLengthPX = (focalLengthMM / sensorWidthMM) * imageWidthPX;
-    __android_log_print(ANDROID_LOG_DEBUG, "CameraInfo", "Focal Length (px): %f", focalLengthPX);
-
-    return focalLengthPX;
-}
 
 
 
@@ -0,0 +1,152 @@
+// Temporal occupancy grid in image space, see occupancy.h
+
+#include "../header/occupancy.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+OccupancyGrid::OccupancyGrid()
+{
+    // Below the occupied threshold so one detection, a false positive included, never occupies a cell.
+    // Two consecutive frames do (0.35, then about 0.57 after the decay of one frame)
+    hit_weight = 0.35f;
+    occupied_threshold = 0.5f;
+    free_threshold = 0.25f;
+
+    frame_width = 0;
+    frame_height = 0;
+
+    configure(6, 6, 600.f);
+}
+
+void OccupancyGrid::configure(int cols, int rows, float half_life_ms)
+{
+    grid_cols = std::max(1, std::min(cols, OCCUPANCY_MAX_COLS));
+    grid_rows = std::max(1, std::min(rows, OCCUPANCY_MAX_ROWS));
+    half_life = std::max(half_life_ms, 1.f);
+    reset();
+}
+
+void OccupancyGrid::reset()
+{
+    for (int i = 0; i < OCCUPANCY_MAX_ROWS * OCCUPANCY_MAX_COLS; i++)
+    {
+        cell_occupancy[i] = 0.f;
+        cell_distance[i] = FLT_MAX;
+        cell_occupied[i] = false;
+        frame_hits[i] = FLT_MAX;
+    }
+    for (int z = 0; z < ZONE_COUNT; z++)
+    {
+        zone_occupied[z] = false;
+        zone_distance[z] = FLT_MAX;
+    }
+    last_timestamp_ms = -1.0;
+}
+
+void OccupancyGrid::begin_frame(int width, int height, double timestamp_ms)
+{
+    // A new frame size means a new crop, the cells no longer cover the same part of the view
+    if (width != frame_width || height != frame_height)
+    {
+        frame_width = width;
+        frame_height = height;
+        reset();
+    }
+
+    if (last_timestamp_ms >= 0.0 && timestamp_ms > last_timestamp_ms)
+    {
+        const float decay = powf(0.5f, (float)(timestamp_ms - last_timestamp_ms) / half_life);
+        for (int row = 0; row < grid_rows; row++)
+        {
+            for (int col = 0; col < grid_cols; col++)
+            {
+                cell_occupancy[row * OCCUPANCY_MAX_COLS + col] *= decay;
+            }
+        }
+    }
+    last_timestamp_ms = timestamp_ms;
+
+    for (int i = 0; i < OCCUPANCY_MAX_ROWS * OCCUPANCY_MAX_COLS; i++)
+    {
+        frame_hits[i] = FLT_MAX;
+    }
+}
+
+void OccupancyGrid::observe_cell(int col, int row, float distance)
+{
+    float& hit = frame_hits[row * OCCUPANCY_MAX_COLS + col];
+    hit = std::min(hit, distance);
+}
+
+void OccupancyGrid::observe_box(float x0, float x1, float y, float distance)
+{
+    if (frame_width <= 0 || frame_height <= 0 || distance <= 0.f)
+        return;
+
+    const int row = std::max(0, std::min((int)(y * grid_rows / frame_height), grid_rows - 1));
+    const int col0 = std::max(0, std::min((int)(x0 * grid_cols / frame_width), grid_cols - 1));
+    const int col1 = std::max(0, std::min((int)(x1 * grid_cols / frame_width), grid_cols - 1));
+    for (int col = col0; col <= col1; col++)
+    {
+        observe_cell(col, row, distance);
+    }
+}
+
+void OccupancyGrid::observe_zone(int zone, float distance)
+{
+    if (zone < 0 || zone >= ZONE_COUNT)
+        return;
+
+    // Cells whose center lies in the zone
+    const int zone_row = zone / 3;
+    const int zone_col = zone % 3;
+    for (int row = 0; row < grid_rows; row++)
+    {
+        if ((2 * row + 1) * 3 / (2 * grid_rows) != zone_row)
+            continue;
+
+        for (int col = 0; col < grid_cols; col++)
+        {
+            if ((2 * col + 1) * 3 / (2 * grid_cols) == zone_col)
+                observe_cell(col, row, distance);
+        }
+    }
+}
+
+void OccupancyGrid::end_frame()
+{
+    for (int z = 0; z < ZONE_COUNT; z++)
+    {
+        zone_occupied[z] = false;
+        zone_distance[z] = FLT_MAX;
+    }
+
+    for (int row = 0; row < grid_rows; row++)
+    {
+        for (int col = 0; col < grid_cols; col++)
+        {
+            const int i = row * OCCUPANCY_MAX_COLS + col;
+
+            if (frame_hits[i] < FLT_MAX)
+            {
+                // A cell that was free takes the new distance, an occupied one follows it smoothly
+                cell_distance[i] = cell_occupancy[i] < free_threshold ? frame_hits[i] : cell_distance[i] + 0.5f * (frame_hits[i] - cell_distance[i]);
+                cell_occupancy[i] += hit_weight * (1.f - cell_occupancy[i]);
+            }
+
+            if (cell_occupied[i] && cell_occupancy[i] < free_threshold)
+                cell_occupied[i] = false;
+            else if (!cell_occupied[i] && cell_occupancy[i] > occupied_threshold)
+                cell_occupied[i] = true;
+
+            if (!cell_occupied[i])
+                continue;
+
+            const int zone = ((2 * row + 1) * 3 / (2 * grid_rows)) * 3 + (2 * col + 1) * 3 / (2 * grid_cols);
+            zone_occupied[zone] = true;
+            zone_distance[zone] = std::min(zone_distance[zone], cell_distance[i]);
+        }
+    }
+}
@@ -0,0 +1,184 @@
+// Polar obstacle histogram for a continuous heading, see polarhistogram.h
+
+#include "../header/polarhistogram.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+PolarHistogram::PolarHistogram()
+{
+    body_half_width = 0.35f;
+    range = 8.f;
+    blocked_threshold = 0.15f;
+    free_threshold = 0.08f;
+    wide_valley_bins = 8;
+
+    frame_width = 0;
+    frame_fx = 0.f;
+    frame_cx = 0.f;
+    min_angle = 0.f;
+    bin_width = 0.f;
+    for (int e = 0; e <= POLAR_BINS; e++)
+    {
+        edge_tan[e] = 0.f;
+    }
+    ahead_bin = POLAR_BINS / 2;
+
+    reset();
+}
+
+int PolarHistogram::configure(const CameraIntrinsics& intrinsics)
+{
+    if (!intrinsics.valid || intrinsics.width <= 0 || intrinsics.fx <= 0.f)
+        return -1;
+
+    if (intrinsics.width == frame_width && intrinsics.fx == frame_fx && intrinsics.cx == frame_cx)
+        return 0;
+
+    frame_width = intrinsics.width;
+    frame_fx = intrinsics.fx;
+    frame_cx = intrinsics.cx;
+
+    min_angle = atanf(-frame_cx / frame_fx);
+    const float max_angle = atanf((frame_width - frame_cx) / frame_fx);
+    bin_width = (max_angle - min_angle) / POLAR_BINS;
+    for (int e = 0; e <= POLAR_BINS; e++)
+    {
+        edge_tan[e] = tanf(min_angle + e * bin_width);
+    }
+
+    ahead_bin = std::max(0, std::min((int)(-min_angle / bin_width), POLAR_BINS - 1));
+
+    // The bins now cover other directions
+    reset();
+    return 0;
+}
+
+void PolarHistogram::reset()
+{
+    for (int b = 0; b < POLAR_BINS; b++)
+    {
+        density[b] = 0.f;
+        blocked[b] = false;
+    }
+    num_obstacles = 0;
+    heading_angle = 0.f;
+    heading_width = 0.f;
+    ahead_density = 0.f;
+}
+
+void PolarHistogram::begin_frame()
+{
+    num_obstacles = 0;
+}
+
+void PolarHistogram::add_obstacle(float x0, float x1, float distance)
+{
+    if (frame_width <= 0 || distance <= 0.f || num_obstacles >= POLAR_MAX_OBSTACLES)
+        return;
+
+    // In tangent space the half body width at the obstacle's distance is a fixed offset
+    const float margin = body_half_width / std::max(distance, 0.3f);
+    obstacle_left[num_obstacles] = (x0 - frame_cx) / frame_fx - margin;
+    obstacle_right[num_obstacles] = (x1 - frame_cx) / frame_fx + margin;
+    obstacle_weight[num_obstacles] = std::max(0.f, 1.f - distance / range);
+    num_obstacles++;
+}
+
+void PolarHistogram::end_frame()
+{
+    const int n = num_obstacles;
+    int first[POLAR_MAX_OBSTACLES];
+    int last[POLAR_MAX_OBSTACLES];
+    float weight[POLAR_MAX_OBSTACLES];
+
+    // Obstacles outside the field of view add nothing
+    const float view_left = edge_tan[0];
+    const float view_right = edge_tan[POLAR_BINS];
+    for (int i = 0; i < n; i++)
+    {
+        const bool visible = obstacle_right[i] >= view_left && obstacle_left[i] <= view_right;
+        weight[i] = visible ? obstacle_weight[i] : 0.f;
+        first[i] = 0;
+        last[i] = 0;
+    }
+
+    // Bins of the obstacle edges, counting the inner bin edges left of each
+    for (int e = 1; e < POLAR_BINS; e++)
+    {
+        const float edge = edge_tan[e];
+        for (int i = 0; i < n; i++)
+        {
+            first[i] += obstacle_left[i] >= edge;
+            last[i] += obstacle_right[i] > edge;
+        }
+    }
+
+    float raw[POLAR_BINS];
+    for (int b = 0; b < POLAR_BINS; b++)
+    {
+        float sum = 0.f;
+        for (int i = 0; i < n; i++)
+        {
+            sum += (first[i] <= b && b <= last[i]) ? weight[i] : 0.f;
+        }
+        raw[b] = sum;
+    }
+
+    // Smooth over the neighbouring bins so that a single bin gap between two obstacles does not count as free
+    for (int b = 0; b < POLAR_BINS; b++)
+    {
+        const float left = raw[std::max(b - 1, 0)];
+        const float right = raw[std::min(b + 1, POLAR_BINS - 1)];
+        density[b] = 0.25f * left + 0.5f * raw[b] + 0.25f * right;
+
+        if (blocked[b] && density[b] < free_threshold)
+            blocked[b] = false;
+        else if (!blocked[b] && density[b] > blocked_threshold)
+            blocked[b] = true;
+    }
+
+    ahead_density = std::min(density[ahead_bin], 1.f);
+
+    // Free valley closest to straight ahead
+    heading_angle = 0.f;
+    heading_width = 0.f;
+    float best_offset = FLT_MAX;
+    int b = 0;
+    while (b < POLAR_BINS)
+    {
+        if (blocked[b])
+        {
+            b++;
+            continue;
+        }
+
+        const int start = b;
+        while (b < POLAR_BINS && !blocked[b])
+        {
+            b++;
+        }
+        const int end = b - 1;
+
+        float angle;
+        if (end - start >= wide_valley_bins)
+        {
+            // Keep half of the wide valley width between the heading and its sides
+            const float lo = bin_angle(start + wide_valley_bins / 2);
+            const float hi = bin_angle(end - wide_valley_bins / 2);
+            angle = std::max(lo, std::min(0.f, hi));
+        }
+        else
+        {
+            angle = 0.5f * (bin_angle(start) + bin_angle(end));
+        }
+
+        if (fabsf(angle) < best_offset)
+        {
+            best_offset = fabsf(angle);
+            heading_angle = angle;
+            heading_width = (end - start + 1) * bin_width;
+        }
+    }
+}
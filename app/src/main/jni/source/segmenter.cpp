@@ -0,0 +1,322 @@
+// On-device semantic segmentation of walkable surfaces, see segmenter.h
+
+#include "../header/segmenter.h"
+
+#include <android/log.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "cpu.h"
+
+// Model input and output blobs
+static const char* SEGMENTER_INPUT_BLOB = "in0";
+static const char* SEGMENTER_OUTPUT_BLOB = "out0";
+
+// A surface must cover this much of a zone to be announced
+static const float CAUTION_MIN_SHARE = 0.25f;
+
+static const char* surface_class_names[SURFACE_CLASS_COUNT] = {
+        "other", "floor", "floor-wood", "rug", "road", "pavement", "grass", "dirt",
+        "gravel", "sand", "snow", "stairs", "bridge", "blanket"
+};
+
+const char* surface_class_name(int label)
+{
+    if (label < 0 || label >= SURFACE_CLASS_COUNT)
+        return "unknown";
+
+    return surface_class_names[label];
+}
+
+bool surface_is_hazard(int label)
+{
+    return label == SURFACE_ROAD || label == SURFACE_STAIRS;
+}
+
+bool surface_is_walkable(int label)
+{
+    return label > SURFACE_OTHER && label < SURFACE_CLASS_COUNT && !surface_is_hazard(label);
+}
+
+bool Segmenter::available(AAssetManager* mgr, const char* modeltype)
+{
+    char parampath[256];
+    char modelpath[256];
+    sprintf(parampath, "segmentation-%s.param", modeltype);
+    sprintf(modelpath, "segmentation-%s.bin", modeltype);
+
+    AAsset* param_asset = AAssetManager_open(mgr, parampath, AASSET_MODE_STREAMING);
+    AAsset* model_asset = AAssetManager_open(mgr, modelpath, AASSET_MODE_STREAMING);
+    const bool found = param_asset && model_asset;
+    if (param_asset)
+        AAsset_close(param_asset);
+    if (model_asset)
+        AAsset_close(model_asset);
+
+    return found;
+}
+
+Segmenter::Segmenter()
+{
+    target_width = 0;
+    target_height = 0;
+
+    blob_pool_allocator.set_size_compare_ratio(0.f);
+    workspace_pool_allocator.set_size_compare_ratio(0.f);
+}
+
+int Segmenter::load(AAssetManager* mgr, const char* modeltype, int _target_width, int _target_height, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
+{
+    segnet.clear();
+    blob_pool_allocator.clear();
+    workspace_pool_allocator.clear();
+
+    segnet.opt = ncnn::Option();
+
+#if NCNN_VULKAN
+    segnet.opt.use_vulkan_compute = use_gpu;
+#endif
+
+    // Runs on its worker thread beside detection, two threads are enough at this resolution
+    segnet.opt.num_threads = std::min(2, ncnn::get_big_cpu_count());
+    segnet.opt.blob_allocator = &blob_pool_allocator;
+    segnet.opt.workspace_allocator = &workspace_pool_allocator;
+
+    char parampath[256];
+    char modelpath[256];
+    sprintf(parampath, "segmentation-%s.param", modeltype);
+    sprintf(modelpath, "segmentation-%s.bin", modeltype);
+
+    if (segnet.load_param(mgr, parampath) != 0 || segnet.load_model(mgr, modelpath) != 0)
+    {
+        __android_log_print(ANDROID_LOG_WARN, "Segmenter", "Segmentation model %s not available", modeltype);
+        segnet.clear();
+        return -1;
+    }
+
+    target_width = _target_width;
+    target_height = _target_height;
+    mean_vals[0] = _mean_vals[0];
+    mean_vals[1] = _mean_vals[1];
+    mean_vals[2] = _mean_vals[2];
+    norm_vals[0] = _norm_vals[0];
+    norm_vals[1] = _norm_vals[1];
+    norm_vals[2] = _norm_vals[2];
+
+    return 0;
+}
+
+int Segmenter::segment(const cv::Mat& rgb, SurfaceZones& zones)
+{
+    if (target_width <= 0 || target_height <= 0)
+        return -1;
+
+    // Straight resize, zones are relative so the aspect ratio does not need to be kept
+    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB, rgb.cols, rgb.rows, target_width, target_height);
+    in.substract_mean_normalize(mean_vals, norm_vals);
+
+    ncnn::Extractor ex = segnet.create_extractor();
+    ex.input(SEGMENTER_INPUT_BLOB, in);
+
+    ncnn::Mat out;
+    if (ex.extract(SEGMENTER_OUTPUT_BLOB, out) != 0 || out.empty())
+        return -1;
+
+    const int w = out.w;
+    const int h = out.h;
+    const int num_class = std::min(out.c, (int)SURFACE_CLASS_COUNT);
+
+    label_mask.create(h, w, CV_8UC1);
+
+    // Per-pixel argmax over the class scores, a single channel output already holds the labels
+    if (out.c == 1)
+    {
+        const float* p = out.channel(0);
+        for (int i = 0; i < w * h; i++)
+        {
+            int label = (int)p[i];
+            label_mask.data[i] = (unsigned char)((label >= 0 && label < SURFACE_CLASS_COUNT) ? label : SURFACE_OTHER);
+        }
+    }
+    else
+    {
+        const float* scores[SURFACE_CLASS_COUNT];
+        for (int c = 0; c < num_class; c++)
+        {
+            scores[c] = out.channel(c);
+        }
+
+        for (int i = 0; i < w * h; i++)
+        {
+            int label = 0;
+            float score = scores[0][i];
+            for (int c = 1; c < num_class; c++)
+            {
+                const float s = scores[c][i];
+                if (s > score)
+                {
+                    label = c;
+                    score = s;
+                }
+            }
+            label_mask.data[i] = (unsigned char)label;
+        }
+    }
+
+    // Count the labels per zone
+    int counts[9][SURFACE_CLASS_COUNT];
+    memset(counts, 0, sizeof(counts));
+    for (int y = 0; y < h; y++)
+    {
+        const int row = std::min(y * 3 / h, 2);
+        const unsigned char* labels = label_mask.ptr<const unsigned char>(y);
+        for (int x = 0; x < w; x++)
+        {
+            const int col = std::min(x * 3 / w, 2);
+            counts[row * 3 + col][labels[x]]++;
+        }
+    }
+
+    for (int z = 0; z < 9; z++)
+    {
+        int total = counts[z][SURFACE_OTHER];
+        int walkable = 0;
+        int hazard = 0;
+        int dominant = SURFACE_OTHER;
+        int dominant_count = 0;
+        for (int c = SURFACE_OTHER + 1; c < SURFACE_CLASS_COUNT; c++)
+        {
+            total += counts[z][c];
+            if (surface_is_hazard(c))
+                hazard += counts[z][c];
+            else
+                walkable += counts[z][c];
+            if (counts[z][c] > dominant_count)
+            {
+                dominant = c;
+                dominant_count = counts[z][c];
+            }
+        }
+
+        zones.walkable[z] = total ? (float)walkable / total : 0.f;
+        zones.hazard[z] = total ? (float)hazard / total : 0.f;
+        zones.dominant[z] = dominant;
+        zones.dominant_share[z] = total ? (float)dominant_count / total : 0.f;
+    }
+    zones.valid = true;
+
+    return 0;
+}
+
+void Segmenter::caution_messages(const SurfaceZones& zones, std::vector<std::string>& messages)
+{
+    if (!zones.valid)
+        return;
+
+    // Near-Center is where the user walks, Mid-Center is the next few steps
+    const int near_center = 7;
+    const int mid_center = 4;
+
+    if (zones.dominant[near_center] != SURFACE_OTHER && zones.dominant_share[near_center] >= CAUTION_MIN_SHARE)
+        messages.push_back(std::string("Caution: Currently walking on ") + surface_class_name(zones.dominant[near_center]) + " at Near-Center.");
+
+    if (zones.dominant[mid_center] != SURFACE_OTHER && zones.dominant_share[mid_center] >= CAUTION_MIN_SHARE)
+        messages.push_back(std::string("Caution: Currently close to ") + surface_class_name(zones.dominant[mid_center]) + " at Mid-Center.");
+}
+
+SegmentationWorker::SegmentationWorker()
+{
+    stopping = false;
+    busy = false;
+    generation = 0;
+    zones.valid = false;
+}
+
+SegmentationWorker::~SegmentationWorker()
+{
+    stop();
+}
+
+void SegmentationWorker::set_segmenter(const std::shared_ptr<Segmenter>& _segmenter)
+{
+    std::lock_guard<std::mutex> g(mutex);
+    segmenter = _segmenter;
+}
+
+bool SegmentationWorker::submit(const cv::Mat& rgb)
+{
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        if (stopping || busy || !segmenter)
+            return false;
+
+        // The thread starts with the first frame, a disabled segmentation costs no thread
+        if (!thread.joinable())
+            thread = std::thread(&SegmentationWorker::run, this);
+
+        pending = rgb.clone();
+        busy = true;
+    }
+    wake.notify_one();
+    return true;
+}
+
+void SegmentationWorker::latest(SurfaceZones& _zones)
+{
+    std::lock_guard<std::mutex> g(mutex);
+    _zones = zones;
+}
+
+void SegmentationWorker::clear()
+{
+    std::lock_guard<std::mutex> g(mutex);
+    zones.valid = false;
+    generation++;
+}
+
+void SegmentationWorker::stop()
+{
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+
+    if (thread.joinable())
+        thread.join();
+}
+
+void SegmentationWorker::run()
+{
+    for (;;)
+    {
+        cv::Mat rgb;
+        std::shared_ptr<Segmenter> frame_segmenter;
+        int frame_generation;
+        {
+            std::unique_lock<std::mutex> g(mutex);
+            wake.wait(g, [this] { return stopping || !pending.empty(); });
+            if (stopping)
+                break;
+
+            rgb = pending;
+            pending = cv::Mat();
+            frame_segmenter = segmenter;
+            frame_generation = generation;
+        }
+
+        SurfaceZones frame_zones;
+        const bool labelled = frame_segmenter && frame_segmenter->segment(rgb, frame_zones) == 0;
+
+        std::lock_guard<std::mutex> g(mutex);
+        if (frame_generation == generation)
+        {
+            if (labelled)
+                zones = frame_zones;
+            else
+                zones.valid = false;
+        }
+        busy = false;
+    }
+}
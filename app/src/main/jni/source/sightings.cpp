@@ -0,0 +1,86 @@
+// Last-seen memory of every class, see sightings.h
+
+#include "../header/sightings.h"
+#include "../header/nanodet.h"
+
+#include <algorithm>
+#include <cstdio>
+
+SightingMemory::SightingMemory()
+{
+    merge_ms = 2000.0;
+    clear();
+}
+
+void SightingMemory::clear()
+{
+    std::lock_guard<std::mutex> g(mutex);
+    for (int label = 0; label < FRAME_MAX_CLASSES; label++)
+    {
+        newest[label] = 0;
+        counts[label] = 0;
+    }
+}
+
+void SightingMemory::record(int label, const Sighting& sighting)
+{
+    if (label < 0 || label >= FRAME_MAX_CLASSES)
+        return;
+
+    std::lock_guard<std::mutex> g(mutex);
+
+    Sighting* ring = entries[label];
+    if (counts[label] > 0)
+    {
+        Sighting& last = ring[newest[label]];
+        if (last.zone == sighting.zone && sighting.timestamp_ms - last.timestamp_ms < merge_ms)
+        {
+            last = sighting;
+            return;
+        }
+    }
+
+    newest[label] = counts[label] > 0 ? (newest[label] + 1) % SIGHTINGS_PER_CLASS : 0;
+    ring[newest[label]] = sighting;
+    counts[label] = std::min(counts[label] + 1, SIGHTINGS_PER_CLASS);
+}
+
+int SightingMemory::read(int label, Sighting* sightings, int max) const
+{
+    if (label < 0 || label >= FRAME_MAX_CLASSES || !sightings)
+        return 0;
+
+    std::lock_guard<std::mutex> g(mutex);
+
+    const int count = std::min(counts[label], max);
+    for (int i = 0; i < count; i++)
+    {
+        sightings[i] = entries[label][(newest[label] - i + SIGHTINGS_PER_CLASS) % SIGHTINGS_PER_CLASS];
+    }
+    return count;
+}
+
+void sighting_sentence(int label, const Sighting& sighting, double now_ms, std::string& text)
+{
+    char buf[128];
+    const int seconds = (int)(std::max(now_ms - sighting.timestamp_ms, 0.0) / 1000.0);
+    if (seconds < 2)
+        sprintf(buf, "%s seen just now at %s. ", nanodet_class_name(label), grid_zone_name(sighting.zone));
+    else if (seconds < 120)
+        sprintf(buf, "%s last seen %d seconds ago at %s. ", nanodet_class_name(label), seconds, grid_zone_name(sighting.zone));
+    else
+        sprintf(buf, "%s last seen %d minutes ago at %s. ", nanodet_class_name(label), seconds / 60, grid_zone_name(sighting.zone));
+    text = buf;
+
+    if (sighting.distance >= 0.f)
+    {
+        const int steps = sighting.distance / 0.75f;
+        if (steps < 1)
+            text += "Less than a step away";
+        else
+        {
+            sprintf(buf, "About %d steps away", steps);
+            text += buf;
+        }
+    }
+}
@@ -0,0 +1,297 @@
+// Multi-object tracker for NanoDet detections, see tracker.h
+
+#include "../header/tracker.h"
+#include "../header/nanodet.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Tracker tuning
+static const float MATCH_IOU_THRESHOLD = 0.3f;   // Minimum IoU between prediction and detection
+static const int MAX_MISSES = 8;                 // Frames a track survives without a match
+static const int MIN_HITS = 3;                   // Matches before a track is reported
+static const int ZONE_CONFIRM_FRAMES = 2;        // Frames a new zone must be seen before it is adopted
+static const float DISTANCE_SMOOTHING = 0.3f;    // Weight of the newest distance in the moving average
+static const float DISTANCE_BAND_METERS = 0.75f; // One step, announce again when distance changes by this much
+static const float ACCEL_NOISE = 400.f * 400.f;  // Process noise, variance of acceleration in (px/s^2)^2
+static const float MEASUREMENT_NOISE = 8.f * 8.f;// Measurement noise, variance of a box coordinate in px^2
+static const float INITIAL_VELOCITY_VAR = 500.f * 500.f;
+
+static void kalman_init(KalmanAxis& k, float z)
+{
+    k.x = z;
+    k.v = 0.f;
+    k.p00 = MEASUREMENT_NOISE;
+    k.p01 = 0.f;
+    k.p11 = INITIAL_VELOCITY_VAR;
+}
+
+// Constant-velocity prediction with white noise acceleration
+static void kalman_predict(KalmanAxis& k, float dt)
+{
+    const float dt2 = dt * dt;
+
+    k.x += k.v * dt;
+
+    k.p00 += dt * (2.f * k.p01 + dt * k.p11) + ACCEL_NOISE * dt2 * dt2 * 0.25f;
+    k.p01 += dt * k.p11 + ACCEL_NOISE * dt2 * dt * 0.5f;
+    k.p11 += ACCEL_NOISE * dt2;
+}
+
+static void kalman_update(KalmanAxis& k, float z)
+{
+    const float s = k.p00 + MEASUREMENT_NOISE;
+    const float k0 = k.p00 / s;
+    const float k1 = k.p01 / s;
+    const float y = z - k.x;
+
+    k.x += k0 * y;
+    k.v += k1 * y;
+
+    const float p00 = k.p00;
+    const float p01 = k.p01;
+    k.p00 -= k0 * p00;
+    k.p01 -= k0 * p01;
+    k.p11 -= k1 * p01;
+}
+
+static float box_iou(const cv::Rect_<float>& a, const cv::Rect_<float>& b)
+{
+    float inter = (a & b).area();
+    float uni = a.area() + b.area() - inter;
+    return uni > 0.f ? inter / uni : 0.f;
+}
+
+cv::Rect_<float> Track::rect() const
+{
+    const float w = std::max(axes[2].x, 1.f);
+    const float h = std::max(axes[3].x, 1.f);
+    return cv::Rect_<float>(axes[0].x - w * 0.5f, axes[1].x - h * 0.5f, w, h);
+}
+
+Tracker::Tracker()
+{
+    candidates.reserve(MAX_TRACKS * 16);
+    det_track_ids.reserve(64);
+    det_slots.reserve(64);
+    reset();
+}
+
+void Tracker::reset()
+{
+    for (int i = 0; i < MAX_TRACKS; i++)
+    {
+        slots[i].id = 0;
+    }
+    next_id = 1;
+    last_timestamp_ms = 0.0;
+    det_track_ids.clear();
+}
+
+bool Tracker::is_confirmed(const Track& track) const
+{
+    return track.id != 0 && track.hits >= MIN_HITS;
+}
+
+cv::Rect_<float> Tracker::predicted_rect(const Track& track, double timestamp_ms) const
+{
+    float dt = last_timestamp_ms > 0.0 ? (float)((timestamp_ms - last_timestamp_ms) / 1000.0) : 0.f;
+    dt = std::min(std::max(dt, 0.f), 1.f);
+
+    const float w = std::max(track.axes[2].x + track.axes[2].v * dt, 1.f);
+    const float h = std::max(track.axes[3].x + track.axes[3].v * dt, 1.f);
+    const float cx = track.axes[0].x + track.axes[0].v * dt;
+    const float cy = track.axes[1].x + track.axes[1].v * dt;
+    return cv::Rect_<float>(cx - w * 0.5f, cy - h * 0.5f, w, h);
+}
+
+void Tracker::update(const std::vector<Object>& objects, const float* distances, const int* zones, double timestamp_ms)
+{
+    float dt = last_timestamp_ms > 0.0 ? (float)((timestamp_ms - last_timestamp_ms) / 1000.0) : 0.f;
+    dt = std::min(std::max(dt, 0.f), 1.f);
+    last_timestamp_ms = timestamp_ms;
+
+    // Predict every live track to the current frame
+    for (int t = 0; t < MAX_TRACKS; t++)
+    {
+        Track& track = slots[t];
+        if (track.id == 0)
+            continue;
+
+        for (int a = 0; a < 4; a++)
+        {
+            kalman_predict(track.axes[a], dt);
+        }
+        track.matched = false;
+    }
+
+    // Collect candidate pairs of the same class above the IoU threshold
+    const int n = objects.size();
+    candidates.clear();
+    for (int t = 0; t < MAX_TRACKS; t++)
+    {
+        const Track& track = slots[t];
+        if (track.id == 0)
+            continue;
+
+        const cv::Rect_<float> predicted = track.rect();
+        for (int i = 0; i < n; i++)
+        {
+            if (objects[i].label != track.label)
+                continue;
+
+            float iou = box_iou(predicted, objects[i].rect);
+            if (iou >= MATCH_IOU_THRESHOLD)
+            {
+                Candidate c;
+                c.iou = iou;
+                c.track = t;
+                c.detection = i;
+                candidates.push_back(c);
+            }
+        }
+    }
+
+    // Greedy assignment, best overlap first
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.iou > b.iou;
+    });
+
+    det_track_ids.assign(n, 0);
+    det_slots.assign(n, -1);
+    for (const Candidate& c : candidates)
+    {
+        Track& track = slots[c.track];
+        if (track.matched || det_slots[c.detection] >= 0)
+            continue;
+
+        const Object& obj = objects[c.detection];
+        kalman_update(track.axes[0], obj.rect.x + obj.rect.width * 0.5f);
+        kalman_update(track.axes[1], obj.rect.y + obj.rect.height * 0.5f);
+        kalman_update(track.axes[2], obj.rect.width);
+        kalman_update(track.axes[3], obj.rect.height);
+
+        track.prob = obj.prob;
+        track.hits++;
+        track.misses = 0;
+        track.matched = true;
+
+        det_track_ids[c.detection] = track.id;
+        det_slots[c.detection] = c.track;
+    }
+
+    // Start new tracks for unmatched detections
+    for (int i = 0; i < n; i++)
+    {
+        if (det_slots[i] >= 0)
+            continue;
+
+        int free_slot = -1;
+        for (int t = 0; t < MAX_TRACKS; t++)
+        {
+            if (slots[t].id == 0)
+            {
+                free_slot = t;
+                break;
+            }
+        }
+
+        // All slots taken, the remaining detections stay untracked this frame
+        if (free_slot < 0)
+            break;
+
+        const Object& obj = objects[i];
+        Track& track = slots[free_slot];
+        track.id = next_id++;
+        track.label = obj.label;
+        track.prob = obj.prob;
+        kalman_init(track.axes[0], obj.rect.x + obj.rect.width * 0.5f);
+        kalman_init(track.axes[1], obj.rect.y + obj.rect.height * 0.5f);
+        kalman_init(track.axes[2], obj.rect.width);
+        kalman_init(track.axes[3], obj.rect.height);
+        track.hits = 1;
+        track.misses = 0;
+        track.matched = true;
+        track.smoothed_distance = -1.f;
+        track.zone = -1;
+        track.pending_zone = -1;
+        track.pending_count = 0;
+        track.announced_zone = -1;
+        track.announced_distance = -1.f;
+
+        det_track_ids[i] = track.id;
+        det_slots[i] = free_slot;
+    }
+
+    // Age out the tracks that were not matched
+    for (int t = 0; t < MAX_TRACKS; t++)
+    {
+        Track& track = slots[t];
+        if (track.id != 0 && !track.matched && ++track.misses > MAX_MISSES)
+            track.id = 0;
+    }
+
+    // Smooth distance and zone of the matched tracks
+    for (int i = 0; i < n; i++)
+    {
+        if (det_slots[i] < 0)
+            continue;
+
+        Track* track = &slots[det_slots[i]];
+
+        const float distance = distances ? distances[i] : -1.f;
+        if (distance > 0.f)
+        {
+            if (track->smoothed_distance > 0.f)
+                track->smoothed_distance += DISTANCE_SMOOTHING * (distance - track->smoothed_distance);
+            else
+                track->smoothed_distance = distance;
+        }
+
+        const int zone = zones ? zones[i] : -1;
+        if (zone < 0 || zone == track->zone)
+        {
+            track->pending_zone = -1;
+            track->pending_count = 0;
+        }
+        else if (track->zone < 0)
+        {
+            track->zone = zone;
+        }
+        else
+        {
+            // Require the new zone on consecutive frames before switching to avoid flicker on boundaries
+            if (zone == track->pending_zone)
+                track->pending_count++;
+            else
+            {
+                track->pending_zone = zone;
+                track->pending_count = 1;
+            }
+
+            if (track->pending_count >= ZONE_CONFIRM_FRAMES)
+            {
+                track->zone = zone;
+                track->pending_zone = -1;
+                track->pending_count = 0;
+            }
+        }
+    }
+}
+
+bool Tracker::take_announcement(Track& track)
+{
+    if (!is_confirmed(track) || !track.matched || track.zone < 0)
+        return false;
+
+    bool zone_changed = track.zone != track.announced_zone;
+    bool distance_changed = track.smoothed_distance > 0.f
+                            && std::fabs(track.smoothed_distance - track.announced_distance) >= DISTANCE_BAND_METERS;
+
+    if (!zone_changed && !distance_changed)
+        return false;
+
+    track.announced_zone = track.zone;
+    track.announced_distance = track.smoothed_distance;
+    return true;
+}